@@ -5,10 +5,12 @@
 #include <fstream>
 #include <math.h>
 #include <memory>
+#include <cstring>
+#include <functional>
 
-#include "tools/job.h"
 #include "tools/text.h"
 #include "tools/record.h"
+#include "tools/histogram.h"
 #include "tools/console.h"
 
 #include "vera/window.h"
@@ -28,13 +30,18 @@
 
 #if defined(DEBUG)
 
-#define TRACK_BEGIN(A) if (uniforms.tracker.isRunning()) uniforms.tracker.begin(A); 
-#define TRACK_END(A) if (uniforms.tracker.isRunning()) uniforms.tracker.end(A); 
+// names are interned once per call site, on its first pass. Ids resolved somewhere else go through the _ID ones
+#define TRACK_BEGIN(A) if (uniforms.tracker.isRunning()) { static const int trackId = uniforms.tracker.getTrackId(A); uniforms.tracker.begin(trackId); }
+#define TRACK_END(A) if (uniforms.tracker.isRunning()) { static const int trackId = uniforms.tracker.getTrackId(A); uniforms.tracker.end(trackId); }
+#define TRACK_BEGIN_ID(A) if (uniforms.tracker.isRunning()) uniforms.tracker.begin(A);
+#define TRACK_END_ID(A) if (uniforms.tracker.isRunning()) uniforms.tracker.end(A);
 
 #else 
 
 #define TRACK_BEGIN(A)
-#define TRACK_END(A) 
+#define TRACK_END(A)
+#define TRACK_BEGIN_ID(A)
+#define TRACK_END_ID(A) 
 
 #endif
 
@@ -54,13 +61,15 @@ GlslViewer::GlslViewer():
     m_postprocessing(false),
     // Plot helpers
     m_plot(PLOT_OFF),
+    m_plot_gpu(true),
+    m_plot_updated(false),
 
     // Record
+    m_record_yuv_check(false),
+    m_record_container_first(0),
     #if defined(SUPPORT_MULTITHREAD_RECORDING)
-    m_task_count(0),
-    /** allow 500 MB to be used for the image save queue **/
-    m_max_mem_in_queue(500 * 1024 * 1024),
-    m_save_threads(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1)),
+    /** up to one thread per core but the render one, and 500 MB for the image save queue **/
+    m_saver(std::max(1, static_cast<int>(std::thread::hardware_concurrency()) - 1), 500 * 1024 * 1024),
     #endif
 
     // Scene
@@ -75,6 +84,10 @@ GlslViewer::GlslViewer():
     // set vera scene values to uniforms
     vera::scene( (vera::Scene*)&uniforms );
 
+    #if defined(SUPPORT_MULTITHREAD_RECORDING)
+    m_saver.setTracker( &uniforms.tracker );
+    #endif
+
     // TIME UNIFORMS
     //
     uniforms.functions["u_frame"] = UniformFunction( "int", [&](vera::Shader& _shader) {
@@ -94,12 +107,7 @@ GlslViewer::GlslViewer():
     } );
 
     uniforms.functions["u_time"] = UniformFunction( "float", [&](vera::Shader& _shader) {
-        if (vera::getWindowStyle() == vera::EMBEDDED) 
-            _shader.setUniform("u_time", float(uniforms.getFrame()) * vera::getRestSec());
-        else if (isRecording()) 
-            _shader.setUniform("u_time", getRecordingTime());
-        else 
-            _shader.setUniform("u_time", float(vera::getTime()) - m_time_offset);
+        _shader.setUniform("u_time", _getTime());
     }, 
     [&]() {  
         if (isRecording()) return vera::toString( getRecordingTime() );
@@ -107,8 +115,7 @@ GlslViewer::GlslViewer():
     } );
 
     uniforms.functions["u_delta"] = UniformFunction("float", [&](vera::Shader& _shader) {
-        if (isRecording()) _shader.setUniform("u_delta", getRecordingDelta());
-        else _shader.setUniform("u_delta", float(vera::getDelta()));
+        _shader.setUniform("u_delta", _getDelta());
     }, 
     [&]() { 
         if (isRecording()) return vera::toString( getRecordingDelta() );
@@ -153,14 +160,27 @@ GlslViewer::GlslViewer():
     uniforms.functions["u_modelViewProjectionMatrix"] = UniformFunction("mat4");
 }
 
+float GlslViewer::_getTime() {
+    if (vera::getWindowStyle() == vera::EMBEDDED) 
+        return float(uniforms.getFrame()) * vera::getRestSec();
+    else if (isRecording()) 
+        return getRecordingTime();
+    return float(vera::getTime()) - m_time_offset;
+}
+
+float GlslViewer::_getDelta() {
+    if (isRecording())
+        return getRecordingDelta();
+    return float(vera::getDelta());
+}
+
 GlslViewer::~GlslViewer() {
     #if defined(SUPPORT_MULTITHREAD_RECORDING)
     /** make sure every frame is saved before exiting **/
-    if (m_task_count > 0)
+    if (m_saver.getPending() > 0)
         std::cout << "saving remaining frames to disk, this might take a while ..." << std::endl;
     
-    while (m_task_count > 0)
-        std::this_thread::sleep_for(std::chrono::milliseconds{10});
+    m_saver.flush();
     
     #endif
 }
@@ -242,11 +262,20 @@ void GlslViewer::commandsInit(CommandList &_commands ) {
 
                 else if (values[1] == "framerate")
                     std::cout << uniforms.tracker.logFramerate();
+
+                else if (values[1] == "gpu")
+                    std::cout << "track,gpu," << (uniforms.tracker.isGpu() ? "on" : "off") << std::endl;
+
+                else if (values[1] == "stats")
+                    std::cout << uniforms.tracker.logStats();
             }
 
             else if (values.size() == 3) {
 
-                if (values[1] == "average" && 
+                if (values[1] == "gpu")
+                    uniforms.tracker.setGpu(values[2] == "on");
+
+                else if (values[1] == "average" && 
                     vera::haveExt(values[2],"csv") ) {
                     std::ofstream out(values[2]);
                     out << uniforms.tracker.logAverage();
@@ -256,6 +285,20 @@ void GlslViewer::commandsInit(CommandList &_commands ) {
                 else if (values[1] == "average")
                     std::cout << uniforms.tracker.logAverage( values[2] );
 
+                else if (   values[1] == "stats" &&
+                            vera::haveExt(values[2],"csv") ) {
+                    std::ofstream out(values[2]);
+                    out << uniforms.tracker.logStats();
+                    out.close();
+                }
+
+                else if (   values[1] == "trace" &&
+                            vera::haveExt(values[2],"json") ) {
+                    std::ofstream out(values[2]);
+                    out << uniforms.tracker.logTrace();
+                    out.close();
+                }
+
                 else if (   values[1] == "samples" && 
                             vera::haveExt(values[2],"csv") ) {
                     std::ofstream out(values[2]);
@@ -289,7 +332,7 @@ void GlslViewer::commandsInit(CommandList &_commands ) {
         }
         return false;
     },
-    "track[,on|off|average|samples]", "start/stop tracking rendering time", false));
+    "track[,on|off|average|samples|stats[,<file>.csv]|gpu[,on|off]|trace,<file>.json]", "start/stop tracking rendering time. Stats gives the percentiles and jitter of each track. With gpu on, average adds the GPU time of each track. Trace saves every thread's samples for chrome://tracing or Perfetto"));
 
     _commands.push_back(Command("glsl_version", [&](const std::string& _line){ 
         if (_line == "glsl_version") {
@@ -368,6 +411,60 @@ void GlslViewer::commandsInit(CommandList &_commands ) {
     },
     "plot[,off|luma|red|green|blue|rgb|fps|ms]", "show/hide a histogram or FPS plot on screen", false));
 
+    _commands.push_back(Command("plot_histogram", [&](const std::string& _line){
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            // only a request, the render thread checks the context and falls back to CPU on its own
+            m_plot_gpu = values[1] == "gpu";
+            return true;
+        }
+        else {
+            std::cout << "plot_histogram," << (m_plot_gpu? "gpu" : "cpu") << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "plot_histogram[,gpu|cpu]", "count the plotted histogram on the GPU or by reading the frame back to the CPU (default gpu)", false));
+
+    _commands.push_back(Command("plot_sampling", [&](const std::string& _line){
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 1) {
+            std::cout << "plot_sampling," << m_plot_sampler.getModeName() << "," << m_plot_sampler.getBudget() << std::endl;
+            return true;
+        }
+
+        size_t i = 1;
+        if (values[i] == "full" || values[i] == "stride" || values[i] == "tiles") {
+            if (values[i] == "stride")
+                m_plot_sampler.setMode(HISTOGRAM_STRIDE);
+            else if (values[i] == "tiles")
+                m_plot_sampler.setMode(HISTOGRAM_TILES);
+            else
+                m_plot_sampler.setMode(HISTOGRAM_FULL);
+            i++;
+        }
+        if (i < values.size() && vera::isInt(values[i]))
+            m_plot_sampler.setBudget(vera::toInt(values[i++]));
+
+        return i == values.size();
+    },
+    "plot_sampling[,full|stride|tiles][,<budget>]", "count only <budget> pixels of the histogram per frame, over a shifting grid or a tile, adding the rest over the next frames (default full, 262144)", false));
+
+    _commands.push_back(Command("plot_bench", [&](const std::string& _line){
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() >= 3) {
+            histogramBenchmark(vera::toInt(values[1]), vera::toInt(values[2]), (values.size() == 4)? vera::toInt(values[3]) : 20);
+            return true;
+        }
+        else if (values.size() == 1) {
+            histogramBenchmark(1920, 1080);
+            histogramBenchmark(3840, 2160);
+            return true;
+        }
+        return false;
+    },
+    "plot_bench[,<width>,<height>[,<iterations>]]", "measure the CPU histogram kernels on synthetic frames (default 1080p and 4K)", false));
+
     _commands.push_back(Command("reset", [&](const std::string& _line){
         if (_line == "reset") {
             m_time_offset = vera::getTime();
@@ -471,6 +568,49 @@ void GlslViewer::commandsInit(CommandList &_commands ) {
     },
     "uniforms[,all|active|defined|textures|buffers|cubemaps|lights|cameras|on|off]", "return a list of uniforms", false));
 
+    _commands.push_back(Command("uniform_policy", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            UniformDataMap::iterator it = uniforms.data.find(values[1]);
+            std::cout << ((it != uniforms.data.end())? it->second.getPolicy() : "queue," + vera::toString(UNIFORM_QUEUE_DEPTH)) << std::endl;
+            return true;
+        }
+        else if (values.size() == 3 && (values[2] == "latest" || values[2] == "average")) {
+            uniforms.data[values[1]].setPolicy( (values[2] == "latest")? UNIFORM_LATEST : UNIFORM_AVERAGE );
+            return true;
+        }
+        else if ((values.size() == 3 || values.size() == 4) && values[2] == "queue") {
+            int depth = (values.size() == 4)? vera::toInt(values[3]) : UNIFORM_QUEUE_DEPTH;
+            if (depth < 1) {
+                std::cout << "The depth of the queue has to be 1 or more" << std::endl;
+                return false;
+            }
+            uniforms.data[values[1]].setPolicy(UNIFORM_QUEUE, depth);
+            return true;
+        }
+        return false;
+    },
+    "uniform_policy,<name>[,latest|average|queue[,<depth>]]", "how values that arrive faster than frames are consumed: only the latest, their average, or one per frame (default, up to " + vera::toString(UNIFORM_QUEUE_DEPTH) + " queued)"));
+
+    _commands.push_back(Command("globals", [&](const std::string& _line){ 
+        if (_line == "globals") {
+            std::cout << (uniforms.globals.isEnabled() ? "on" : "off") << std::endl;
+            return true;
+        }
+
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2 && (values[1] == "on" || values[1] == "off")) {
+            uniforms.setGlobals(values[1] == "on");
+            if (values[1] == "on")
+                addDefine("GLSLVIEWER_GLOBALS", GlobalsBlock::getSource());
+            else
+                delDefine("GLSLVIEWER_GLOBALS");
+            return true;
+        }
+        return false;
+    },
+    "globals[,on|off]", "share the per frame uniforms through a uniform buffer. Shaders (GLSL 1.40+ or ES 3.0) declare it with GLSLVIEWER_GLOBALS"));
+
     _commands.push_back(Command("textures", [&](const std::string& _line){ 
         if (_line == "textures") {
             uniforms.printTextures();
@@ -1183,15 +1323,58 @@ void GlslViewer::commandsInit(CommandList &_commands ) {
     _commands.push_back(Command("max_mem_in_queue", [&](const std::string & line) {
         std::vector<std::string> values = vera::split(line,',');
         if (values.size() == 2) {
-            m_max_mem_in_queue = std::stoll(values[1]);
+            m_saver.setMaxMemory( std::stoll(values[1]) );
         }
         else {
-            std::cout << m_max_mem_in_queue.load() << std::endl;
+            std::cout << m_saver.getMaxMemory() << std::endl;
         }
         return false;
     }, "max_mem_in_queue[,<bytes>]", "set the maximum amount of memory used by a queue to export images to disk"));
+
+    _commands.push_back(Command("save_threads", [&](const std::string & line) {
+        std::vector<std::string> values = vera::split(line,',');
+        if (values.size() == 2) {
+            m_saver.setMaxThreads( vera::toInt(values[1]) );
+            return true;
+        }
+        else {
+            m_saver.printStats();
+            return true;
+        }
+        return false;
+    }, "save_threads[,<max>]", "print the state of the threads saving images or set the maximum amount of them"));
+
+    _commands.push_back(Command("png_compression", [&](const std::string & line) {
+        std::vector<std::string> values = vera::split(line,',');
+        if (values.size() == 2) {
+            m_saver.setPngCompression( (values[1] == "auto")? -1 : vera::toInt(values[1]) );
+            return true;
+        }
+        else {
+            int level = m_saver.getPngCompression();
+            std::cout << ((level < 0)? "auto" : vera::toString(level)) << std::endl;
+            return true;
+        }
+        return false;
+    }, "png_compression[,auto|<0-9>]", "zlib level of saved PNGs. Auto lowers it while the savers can't keep up (default auto)"));
     #endif
 
+    _commands.push_back(Command("gpu_yuv", [&](const std::string & line) {
+        std::vector<std::string> values = vera::split(line,',');
+        if (values.size() == 2) {
+            if (values[1] == "check")
+                m_record_yuv_check = true;
+            else
+                setRecordingGpuYuv(values[1] == "on");
+            return true;
+        }
+        else {
+            std::cout << (isRecordingGpuYuv()? "on" : "off") << std::endl;
+            return true;
+        }
+        return false;
+    }, "gpu_yuv[,on|off|check]", "convert recorded video frames to YUV on the GPU before reading them back (default on). Check compares it with the CPU conversion"));
+
     if (vert_index != -1 || geom_index != -1) {
         m_sceneRender.commandsInit(_commands, uniforms);
         m_sceneRender.uniformsInit(uniforms);
@@ -1328,6 +1511,9 @@ void GlslViewer::addDefine(const std::string &_define, const std::string &_value
 
     m_postprocessing_shader.addDefine(_define, _value);
     vera::flagChange();
+
+    // every pass was recompiled, not only the models ones
+    uniforms.invalidateCache();
 }
 
 void GlslViewer::delDefine(const std::string &_define) {
@@ -1346,6 +1532,9 @@ void GlslViewer::delDefine(const std::string &_define) {
 
     m_postprocessing_shader.delDefine(_define);
     vera::flagChange();
+
+    // every pass was recompiled, not only the models ones
+    uniforms.invalidateCache();
 }
 
 // ------------------------------------------------------------------------- GET
@@ -1358,6 +1547,8 @@ bool GlslViewer::haveChange() {
     return  vera::haveChanged() ||
             uniforms.haveChange() ||
             isRecording() ||
+            m_record_yuv_check ||
+            m_plot_updated ||
             screenshotFile != "";
 }
 
@@ -1675,6 +1866,23 @@ void GlslViewer::_updateBuffers() {
         m_flood_subshaders[i].setSource(m_frag_source, vera::getDefaultSrc(vera::VERT_BILLBOARD));
     }
 
+    // Track ids of every pass, so tracking them doesn't build their names on each frame
+    m_buffers_tracks.resize(m_buffers_total);
+    for (int i = 0; i < m_buffers_total; i++)
+        m_buffers_tracks[i] = uniforms.tracker.getTrackId("render:buffer" + vera::toString(i));
+    m_doubleBuffers_tracks.resize(m_doubleBuffers_total);
+    for (int i = 0; i < m_doubleBuffers_total; i++)
+        m_doubleBuffers_tracks[i] = uniforms.tracker.getTrackId("render:doubleBuffer" + vera::toString(i));
+    m_pyramid_tracks.resize(m_pyramid_total);
+    for (int i = 0; i < m_pyramid_total; i++)
+        m_pyramid_tracks[i] = uniforms.tracker.getTrackId("render:pyramid" + vera::toString(i));
+    m_flood_tracks.resize(m_flood_total);
+    for (int i = 0; i < m_flood_total; i++)
+        m_flood_tracks[i] = uniforms.tracker.getTrackId("render:flood" + vera::toString(i));
+
+    // passes were just compiled, their programs may reuse the ids of old ones
+    uniforms.invalidateCache();
+
     // Update Postprocessing
     if (m_postprocessing || m_plot == PLOT_RGB || m_plot == PLOT_RED || m_plot == PLOT_GREEN || m_plot == PLOT_BLUE || m_plot == PLOT_LUMA) {
         if (quilt_resolution >= 0)
@@ -1685,6 +1893,23 @@ void GlslViewer::_updateBuffers() {
 
 }
 
+void GlslViewer::_updateGlobals() {
+    GlobalsData& g = uniforms.globals.data;
+    g.time = _getTime();
+    g.delta = _getDelta();
+    g.frame = (int)uniforms.getFrame();
+    g.date = vera::getDate();
+    g.mouse = vera::getMousePositionFlipped();
+    g.resolution = glm::vec2(vera::getWindowWidth(), vera::getWindowHeight());
+    g.pixelDensity = vera::pixelDensity();
+
+    // the context can't do it, go back to plain uniforms
+    if (!uniforms.updateGlobals()) {
+        uniforms.setGlobals(false);
+        delDefine("GLSLVIEWER_GLOBALS");
+    }
+}
+
 // ------------------------------------------------------------------------- DRAW
 void GlslViewer::_renderBuffers() {
     glDisable(GL_BLEND);
@@ -1694,7 +1919,7 @@ void GlslViewer::_renderBuffers() {
         if (!(uniforms.buffers[i]->enabled || m_update_buffers))
             continue;
 
-        TRACK_BEGIN("render:buffer" + vera::toString(i))
+        TRACK_BEGIN_ID(m_buffers_tracks[i])
 
         reset_viewport += uniforms.buffers[i]->scale <= 0.0;
 
@@ -1709,16 +1934,16 @@ void GlslViewer::_renderBuffers() {
         // Pass textures for the other buffers
         for (size_t j = 0; j < uniforms.buffers.size(); j++)
             if (i != j)
-                m_buffers_shaders[i].setUniformTexture("u_buffer" + vera::toString(j), uniforms.buffers[j]  );
+                m_buffers_shaders[i].setUniformTexture(indexedName(m_buffers_names, "u_buffer", j), uniforms.buffers[j]  );
 
         for (size_t j = 0; j < uniforms.doubleBuffers.size(); j++)
-            m_buffers_shaders[i].setUniformTexture("u_doubleBuffer" + vera::toString(j), uniforms.doubleBuffers[j]->src );
+            m_buffers_shaders[i].setUniformTexture(indexedName(m_doubleBuffers_names, "u_doubleBuffer", j), uniforms.doubleBuffers[j]->src );
 
         for (size_t j = 0; j < uniforms.floods.size(); j++)
-            m_buffers_shaders[i].setUniformTexture("u_flood" + vera::toString(j), uniforms.floods[j].dst );
+            m_buffers_shaders[i].setUniformTexture(indexedName(m_flood_names, "u_flood", j), uniforms.floods[j].dst );
 
         for (size_t j = 0; j < m_sceneRender.buffersFbo.size(); j++)
-            m_buffers_shaders[i].setUniformTexture("u_sceneBuffer" + vera::toString(j), m_sceneRender.buffersFbo[j] );
+            m_buffers_shaders[i].setUniformTexture(indexedName(m_sceneBuffers_names, "u_sceneBuffer", j), m_sceneRender.buffersFbo[j] );
 
         // Update uniforms and textures
         uniforms.feedTo( &m_buffers_shaders[i], true, false);
@@ -1727,11 +1952,11 @@ void GlslViewer::_renderBuffers() {
         
         uniforms.buffers[i]->unbind();
 
-        TRACK_END("render:buffer" + vera::toString(i))
+        TRACK_END_ID(m_buffers_tracks[i])
     }
 
     for (size_t i = 0; i < uniforms.doubleBuffers.size(); i++) {
-        TRACK_BEGIN("render:doubleBuffer" + vera::toString(i))
+        TRACK_BEGIN_ID(m_doubleBuffers_tracks[i])
 
         reset_viewport += uniforms.doubleBuffers[i]->src->scale <= 0.0;
 
@@ -1741,16 +1966,16 @@ void GlslViewer::_renderBuffers() {
 
         // Pass textures for the other buffers
         for (size_t j = 0; j < uniforms.buffers.size(); j++)
-            m_doubleBuffers_shaders[i].setUniformTexture("u_buffer" + vera::toString(j), uniforms.buffers[j] );
+            m_doubleBuffers_shaders[i].setUniformTexture(indexedName(m_buffers_names, "u_buffer", j), uniforms.buffers[j] );
 
         for (size_t j = 0; j < uniforms.doubleBuffers.size(); j++)
-            m_doubleBuffers_shaders[i].setUniformTexture("u_doubleBuffer" + vera::toString(j), uniforms.doubleBuffers[j]->src );
+            m_doubleBuffers_shaders[i].setUniformTexture(indexedName(m_doubleBuffers_names, "u_doubleBuffer", j), uniforms.doubleBuffers[j]->src );
 
         for (size_t j = 0; j < uniforms.floods.size(); j++)
-            m_doubleBuffers_shaders[i].setUniformTexture("u_flood" + vera::toString(j), uniforms.floods[j].dst );
+            m_doubleBuffers_shaders[i].setUniformTexture(indexedName(m_flood_names, "u_flood", j), uniforms.floods[j].dst );
 
         for (size_t j = 0; j < m_sceneRender.buffersFbo.size(); j++)
-            m_doubleBuffers_shaders[i].setUniformTexture("u_sceneBuffer" + vera::toString(j), m_sceneRender.buffersFbo[j] );
+            m_doubleBuffers_shaders[i].setUniformTexture(indexedName(m_sceneBuffers_names, "u_sceneBuffer", j), m_sceneRender.buffersFbo[j] );
 
         // Update uniforms and textures
         uniforms.feedTo( &m_doubleBuffers_shaders[i], true, false);
@@ -1760,11 +1985,11 @@ void GlslViewer::_renderBuffers() {
         uniforms.doubleBuffers[i]->dst->unbind();
         uniforms.doubleBuffers[i]->swap();
 
-        TRACK_END("render:doubleBuffer" + vera::toString(i))
+        TRACK_END_ID(m_doubleBuffers_tracks[i])
     }
 
     for (size_t i = 0; i < m_pyramid_subshaders.size(); i++) {
-        TRACK_BEGIN("render:pyramid" + vera::toString(i))
+        TRACK_BEGIN_ID(m_pyramid_tracks[i])
 
         reset_viewport += m_pyramid_fbos[i].scale <= 0.0;
 
@@ -1780,7 +2005,7 @@ void GlslViewer::_renderBuffers() {
 
         for (size_t j = 0; j < m_sceneRender.buffersFbo.size(); j++)
             if (m_sceneRender.buffersFbo[j]->isAllocated())
-                m_pyramid_subshaders[i].setUniformTexture("u_sceneBuffer" + vera::toString(j), m_sceneRender.buffersFbo[j] );
+                m_pyramid_subshaders[i].setUniformTexture(indexedName(m_sceneBuffers_names, "u_sceneBuffer", j), m_sceneRender.buffersFbo[j] );
 
         vera::billboard()->render( &m_pyramid_subshaders[i] );
 
@@ -1789,11 +2014,11 @@ void GlslViewer::_renderBuffers() {
         vera::blendMode(vera::BLEND_ALPHA);
         uniforms.pyramids[i].process(&m_pyramid_fbos[i]);
 
-        TRACK_END("render:pyramid" + vera::toString(i))
+        TRACK_END_ID(m_pyramid_tracks[i])
     }
 
     for (size_t i = 0; i < m_flood_subshaders.size(); i++) {
-        TRACK_BEGIN("render:flood" + vera::toString(i))
+        TRACK_BEGIN_ID(m_flood_tracks[i])
 
         reset_viewport += uniforms.floods[i].scale <= 0.0;
 
@@ -1805,17 +2030,17 @@ void GlslViewer::_renderBuffers() {
         glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
         for (size_t j = 0; j < uniforms.buffers.size(); j++)
-            m_flood_subshaders[i].setUniformTexture("u_buffer" + vera::toString(j), uniforms.buffers[j] );
+            m_flood_subshaders[i].setUniformTexture(indexedName(m_buffers_names, "u_buffer", j), uniforms.buffers[j] );
 
         for (size_t j = 0; j < uniforms.doubleBuffers.size(); j++)
-            m_flood_subshaders[i].setUniformTexture("u_doubleBuffer" + vera::toString(j), uniforms.doubleBuffers[j]->src );
+            m_flood_subshaders[i].setUniformTexture(indexedName(m_doubleBuffers_names, "u_doubleBuffer", j), uniforms.doubleBuffers[j]->src );
 
         for (size_t j = 0; j < uniforms.floods.size(); j++)
-            m_flood_subshaders[i].setUniformTexture("u_flood" + vera::toString(j), uniforms.floods[j].src );
+            m_flood_subshaders[i].setUniformTexture(indexedName(m_flood_names, "u_flood", j), uniforms.floods[j].src );
 
         for (size_t j = 0; j < m_sceneRender.buffersFbo.size(); j++)
             if (m_sceneRender.buffersFbo[j]->isAllocated())
-                m_flood_subshaders[i].setUniformTexture("u_sceneBuffer" + vera::toString(j), m_sceneRender.buffersFbo[j] );
+                m_flood_subshaders[i].setUniformTexture(indexedName(m_sceneBuffers_names, "u_sceneBuffer", j), m_sceneRender.buffersFbo[j] );
 
         // Update uniforms and textures
         uniforms.feedTo( &m_flood_subshaders[i], true, false );
@@ -1827,7 +2052,7 @@ void GlslViewer::_renderBuffers() {
         vera::blendMode(vera::BLEND_ALPHA);
         uniforms.floods[i].process();
 
-        TRACK_END("render:flood" + vera::toString(i))
+        TRACK_END_ID(m_flood_tracks[i])
     }
 
     #if defined(__EMSCRIPTEN__)
@@ -1859,6 +2084,11 @@ void GlslViewer::renderPrep() {
         }
     }
 
+    // GLOBALS
+    // -----------------------------------------------
+    if (uniforms.globals.isEnabled())
+        _updateGlobals();
+
     // BUFFERS
     // -----------------------------------------------
     if (m_update_buffers ||
@@ -2009,7 +2239,7 @@ void GlslViewer::renderPost() {
         uniforms.feedTo( &m_postprocessing_shader, true, true );
 
         for (size_t i = 0; i < m_sceneRender.buffersFbo.size(); i++)
-            m_postprocessing_shader.setUniformTexture("u_sceneBuffer" + vera::toString(i), m_sceneRender.buffersFbo[i]);//, m_postprocessing_shader.textureIndex++);
+            m_postprocessing_shader.setUniformTexture(indexedName(m_sceneBuffers_names, "u_sceneBuffer", i), m_sceneRender.buffersFbo[i]);//, m_postprocessing_shader.textureIndex++);
 
         if (lenticular.size() > 0)
             feedLenticularUniforms(m_postprocessing_shader);
@@ -2397,12 +2627,26 @@ void GlslViewer::renderUI() {
 }
 
 void GlslViewer::renderDone() {
+    // GPU times of previous frames that are ready by now
+    uniforms.tracker.collect();
+    uniforms.tracker.frame();
+
     TRACK_BEGIN("update:post_render")
 
     // RECORD
     if (isRecording()) {
-        onScreenshot( vera::toString( getRecordingCount() , 0, 5, '0') + ".png");
+        onScreenshot( vera::toString( getRecordingCount() , 0, 5, '0') + "." + getSequenceExt());
+
+        // frames still in flight need to reach the saver/encoder before the recording closes
+        if (isRecordingLastFrame())
+            onRecordFlush();
+
         recordingFrameAdded();
+
+        if (!isRecording() && m_record_container.isOpen()) {
+            std::cout << "Sequence saved to " << m_record_container.getPath() << std::endl;
+            m_record_container.close();
+        }
     }
     // SCREENSHOT 
     else if (screenshotFile != "") {
@@ -2410,9 +2654,19 @@ void GlslViewer::renderDone() {
         screenshotFile = "";
     }
 
+    // needs the GL context, so it runs here instead of on the command thread
+    if (m_record_yuv_check) {
+        int width = vera::getWindowWidth() - vera::getWindowWidth() % 8;
+        int height = vera::getWindowHeight() - vera::getWindowHeight() % 4;
+        YuvPass pass;
+        pass.check(width, height);
+        m_record_yuv_check = false;
+    }
+
     vera::resetChange();
     uniforms.resetChange();
     m_change_viewport = false;
+    m_plot_updated = false;
 
     if (m_plot != PLOT_OFF)
         onPlot();
@@ -2710,48 +2964,44 @@ void GlslViewer::onScreenshot(std::string _file) {
             glReadPixels(0, 0, vera::getWindowWidth(), vera::getWindowHeight(), GL_RGBA, GL_FLOAT, pixels);
             vera::savePixelsFloat(_file, pixels, vera::getWindowWidth(), vera::getWindowHeight());
         }
-        #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
-        else if (recordingPipe()) {
+        else if (isRecording()) {
+            // Recorded frames are read asynchronously, so the readback of this frame 
+            // overlaps with the rendering of the next one
             int width = vera::getWindowWidth();
             int height = vera::getWindowHeight();
-            auto pixels = std::unique_ptr<unsigned char[]>(new unsigned char [width * height * 3]);
-            glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels.get());
-            recordingPipeFrame( std::move(pixels) );
+            int channels = recordingPipe()? recordingPipeChannels() : 4;
+
+            // The encoder takes YUV 4:2:0, converting it on the GPU shrinks the readback to 1.5 bytes per pixel
+            if (recordingPipeYuv()) {
+                TRACK_BEGIN("screenshot:yuv")
+                if (!m_record_yuv.isAllocated(width, height))
+                    m_record_yuv.allocate(width, height);
+                m_record_yuv.process(&m_record_fbo);
+                TRACK_END("screenshot:yuv")
+
+                glBindFramebuffer(GL_FRAMEBUFFER, m_record_yuv.getFbo().getId());
+                width = m_record_yuv.getFboWidth();
+                height = m_record_yuv.getFboHeight();
+                channels = 4;
+            }
+
+            if (!m_record_readback.isAllocated(width, height, channels)) {
+                onRecordFlush();
+                m_record_readback.allocate(width, height, channels);
+            }
+
+            ReadbackCallback callback = std::bind(&GlslViewer::_onRecordFrame, this, 
+                                                    std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, 
+                                                    std::placeholders::_4, std::placeholders::_5);
+            m_record_readback.read(_file, callback);
+            m_record_readback.collect(callback);
         }
-        #endif
         else {
             int width = vera::getWindowWidth();
             int height = vera::getWindowHeight();
-            auto pixels = std::unique_ptr<unsigned char[]>(new unsigned char [width * height * 4]);
+            Pixels pixels = Pixels(new unsigned char [width * height * 4]);
             glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, pixels.get());
-
-            #if defined(SUPPORT_MULTITHREAD_RECORDING) && !defined(PYTHON_RENDER)
-            std::shared_ptr<Job> saverPtr = std::make_shared<Job>(std::move(_file), width, height, std::move(pixels), m_task_count, m_max_mem_in_queue);
-            /** In the case that we render faster than we can safe frames, more and more frames
-             * have to be stored temporary in the save queue. That means that more and more ram is used.
-             * If to much is memory is used, we save the current frame directly to prevent that the system
-             * is running out of memory. Otherwise we put the frame in to the thread queue, so that we can utilize
-             * multilple cpu cores */
-            if (m_max_mem_in_queue <= 0) {
-                Job& saver = *saverPtr;
-                saver();
-            }
-            else {
-                auto func = [saverPtr]() {
-                    Job& saver = *saverPtr;
-                    saver();
-                };
-                m_save_threads.Submit(std::move(func));
-            }
-            #else
-
-            vera::savePixels(_file, pixels.get(), width, height);
-            if (vera::getExt(_file) == "png" || 
-                vera::getExt(_file) == "jpg" || vera::getExt(_file) == "jpeg")
-                m_postprocessing_shader.addDefinesTo(_file);
-            
-            #endif
-
+            _savePixels(_file, width, height, std::move(pixels));
         }
     
         if ( !isRecording() )
@@ -2766,60 +3016,120 @@ void GlslViewer::onScreenshot(std::string _file) {
     }
 }
 
+void GlslViewer::onRecordFlush() {
+    if (m_record_readback.getPending() == 0)
+        return;
+
+    TRACK_BEGIN("screenshot:flush")
+    m_record_readback.collect(std::bind(&GlslViewer::_onRecordFrame, this, 
+                                        std::placeholders::_1, std::placeholders::_2, std::placeholders::_3, 
+                                        std::placeholders::_4, std::placeholders::_5), true);
+    TRACK_END("screenshot:flush")
+}
+
+void GlslViewer::_onRecordFrame(const std::string& _file, int _width, int _height, int _channels, const unsigned char* _pixels) {
+    size_t size = (size_t)_width * _height * _channels;
+
+    // Containers are preallocated and mapped, so saving a frame is just a copy. No need to queue it
+    if (isSequenceContainer() && !recordingPipe()) {
+        int index = vera::toInt( _file.substr(0, _file.size() - vera::getExt(_file).size() - 1) );
+        if (!m_record_container.isOpen()) {
+            m_record_container_first = index;
+            m_record_container.open(_file, _width, _height, getSequenceFormat() == SEQUENCE_CONTAINER_HALF, std::max(1, getRecordingTotal()));
+        }
+
+        TRACK_BEGIN("screenshot:container")
+        m_record_container.write(index - m_record_container_first, index, getRecordingTimeOf(index), _pixels);
+        TRACK_END("screenshot:container")
+        return;
+    }
+
+    // The pool is sized from the frame dimensions and lives while there are frames using it
+    if (!m_record_pool || m_record_pool->getBufferSize() != size) {
+        size_t capacity = 4;
+        #if defined(SUPPORT_MULTITHREAD_RECORDING) && !defined(PYTHON_RENDER)
+        capacity = 2 + m_saver.getMaxThreads() * 2;
+        size_t budget = (size_t)std::max(0LL, m_saver.getMaxMemory()) / size;
+        capacity = std::max((size_t)2, std::min(capacity, budget));
+        #endif
+        m_record_pool = PixelPool::create(size, capacity);
+    }
+
+    TRACK_BEGIN("screenshot:acquire")
+    Pixels pixels = m_record_pool->acquire();
+    TRACK_END("screenshot:acquire")
+    std::memcpy(pixels.get(), _pixels, size);
+
+    #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
+    if (recordingPipe()) {
+        recordingPipeFrame( std::move(pixels) );
+        return;
+    }
+    #endif
+
+    _savePixels(_file, _width, _height, std::move(pixels));
+}
+
+void GlslViewer::_savePixels(const std::string& _file, int _width, int _height, Pixels&& _pixels) {
+    #if defined(SUPPORT_MULTITHREAD_RECORDING) && !defined(PYTHON_RENDER)
+    /** In the case that we render faster than we can safe frames, more and more frames
+     * have to be stored temporary in the save queue. Once it uses all the memory allowed
+     * the saver makes us wait for a frame to be done, instead of saving it on this thread */
+    TRACK_BEGIN("screenshot:submit")
+    m_saver.submit(_file, _width, _height, std::move(_pixels));
+    TRACK_END("screenshot:submit")
+    #else
+
+    rawSavePixels(_file, _pixels.get(), _width, _height);
+    if (vera::getExt(_file) == "png" || 
+        vera::getExt(_file) == "jpg" || vera::getExt(_file) == "jpeg")
+        m_postprocessing_shader.addDefinesTo(_file);
+    
+    #endif
+}
+
 void GlslViewer::onPlot() {
     // if ( !vera::isGL() )
     //     return;
     if (!m_sceneRender.renderFbo.isAllocated())
         return;
 
-    if ( (m_plot == PLOT_LUMA || m_plot == PLOT_RGB || m_plot == PLOT_RED || m_plot == PLOT_GREEN || m_plot == PLOT_BLUE ) && haveChange() ) {
-        TRACK_BEGIN("plot::histogram")
-
-
-        // Extract pixels
-        glBindFramebuffer(GL_FRAMEBUFFER, m_sceneRender.renderFbo.getId());
-        int w = vera::getWindowWidth();
-        int h = vera::getWindowHeight();
-        int c = 3;
-        int total = w * h * c;
-        unsigned char* pixels = new unsigned char[total];
-        glReadPixels(0, 0, w, h, GL_RGB, GL_UNSIGNED_BYTE, pixels);
-        glBindFramebuffer(GL_FRAMEBUFFER, 0);
+    bool histogram = m_plot == PLOT_LUMA || m_plot == PLOT_RGB || m_plot == PLOT_RED || m_plot == PLOT_GREEN || m_plot == PLOT_BLUE;
+    if ( histogram && haveChange() )
+        m_plot_sampler.invalidate();
 
-        // Count frequencies of appearances 
-        float max_rgb_freq = 0;
-        float max_luma_freq = 0;
-        glm::vec4 freqs[256];
-        for (int i = 0; i < total; i += c) {
-            m_plot_values[pixels[i]].r++;
-            if (m_plot_values[pixels[i]].r > max_rgb_freq)
-                max_rgb_freq = m_plot_values[pixels[i]].r;
+    // Keeps counting while some part of the frame is outdated
+    if ( histogram && m_plot_sampler.isPending() ) {
+        TRACK_BEGIN("plot::histogram")
 
-            m_plot_values[pixels[i+1]].g++;
-            if (m_plot_values[pixels[i+1]].g > max_rgb_freq)
-                max_rgb_freq = m_plot_values[pixels[i+1]].g;
+        int w = m_sceneRender.renderFbo.getWidth();
+        int h = m_sceneRender.renderFbo.getHeight();
+        HistogramRegion region = m_plot_sampler.next(w, h);
+        glm::vec4 counts[256];
 
-            m_plot_values[pixels[i+2]].b++;
-            if (m_plot_values[pixels[i+2]].b > max_rgb_freq)
-                max_rgb_freq = m_plot_values[pixels[i+2]].b;
+        // Count frequencies of appearances on the GPU, only the 256 bins are read back
+        if ( !(m_plot_gpu && m_plot_histogram.process(&m_sceneRender.renderFbo, w, h, region, counts)) ) {
+            // Extract pixels
+            glBindFramebuffer(GL_FRAMEBUFFER, m_sceneRender.renderFbo.getId());
+            unsigned char* pixels = new unsigned char[region.width * region.height * 4];
+            glReadPixels(region.x, region.y, region.width, region.height, GL_RGBA, GL_UNSIGNED_BYTE, pixels);
+            glBindFramebuffer(GL_FRAMEBUFFER, 0);
 
-            int luma = 0.299 * pixels[i] + 0.587 * pixels[i+1] + 0.114 * pixels[i+2];
-            m_plot_values[luma].a++;
-            if (m_plot_values[luma].a > max_luma_freq)
-                max_luma_freq = m_plot_values[luma].a;
+            histogramCount(pixels, region.width * 4, region.width, region.height, 4, counts, 0, region.step);
+            delete[] pixels;
         }
-        delete[] pixels;
 
-        // Normalize frequencies
-        for (int i = 0; i < 256; i ++)
-            m_plot_values[i] = m_plot_values[i] / glm::vec4(max_rgb_freq, max_rgb_freq, max_rgb_freq, max_luma_freq);
+        m_plot_sampler.add(counts, &m_plot_values[0]);
+        histogramNormalize(&m_plot_values[0]);
 
         if (m_plot_texture == nullptr)
             m_plot_texture = new vera::Texture();
         m_plot_texture->load(256, 1, 4, 32, &m_plot_values[0], vera::NEAREST, vera::CLAMP);
 
         uniforms.textures["u_histogram"] = m_plot_texture;
-        uniforms.flagChange();
+
+        // Draws one more frame to show it, without flagging a scene change that would invalidate the sampler again
+        m_plot_updated = true;
         TRACK_END("plot::histogram")
     }
 
@@ -1,12 +1,18 @@
 #pragma once
 
-#if defined(SUPPORT_MULTITHREAD_RECORDING)
 #include <atomic>
-#include "thread_pool/thread_pool.hpp"
+
+#if defined(SUPPORT_MULTITHREAD_RECORDING)
+#include "tools/frameSaver.h"
 #endif
 
 #include "sceneRender.h"
 #include "tools/files.h"
+#include "tools/readback.h"
+#include "tools/pixelPool.h"
+#include "tools/yuvPass.h"
+#include "tools/histogramPass.h"
+#include "tools/rawSequence.h"
 #include "vera/ops/string.h"
 
 enum ShaderType {
@@ -65,6 +71,7 @@ public:
     void                onWindowResize( int _newWidth, int _newHeight );
     void                onFileChange( WatchFileList &_files, int _index );
     void                onScreenshot( std::string _file );
+    void                onRecordFlush();
     void                onPlot();
    
     // Include folders
@@ -93,6 +100,11 @@ public:
 protected:
     void                _updateBuffers();
     void                _renderBuffers();
+    void                _updateGlobals();
+    float               _getTime();
+    float               _getDelta();
+    void                _onRecordFrame(const std::string& _file, int _width, int _height, int _channels, const unsigned char* _pixels);
+    void                _savePixels(const std::string& _file, int _width, int _height, Pixels&& _pixels);
 
     // Main Shader
     std::string         m_frag_source;
@@ -105,27 +117,35 @@ protected:
     // Buffers
     ShaderList          m_buffers_shaders;
     int                 m_buffers_total;
+    std::vector<int>    m_buffers_tracks;
+    vera::StringList    m_buffers_names;
 
     // Double Buffers
     ShaderList          m_doubleBuffers_shaders;
     int                 m_doubleBuffers_total;
+    std::vector<int>    m_doubleBuffers_tracks;
+    vera::StringList    m_doubleBuffers_names;
 
     // Pyramids
     FboList             m_pyramid_fbos;
     ShaderList          m_pyramid_subshaders;
     vera::Shader        m_pyramid_shader;
     int                 m_pyramid_total;
+    std::vector<int>    m_pyramid_tracks;
 
     // Floods
     ShaderList          m_flood_subshaders;
     vera::Shader        m_flood_shader;
     int                 m_flood_total;
+    std::vector<int>    m_flood_tracks;
+    vera::StringList    m_flood_names;
 
     // A. CANVAS
     vera::Shader        m_canvas_shader;
 
     // B. SCENE
     SceneRender         m_sceneRender;
+    vera::StringList    m_sceneBuffers_names;
     
     // Postprocessing
     vera::Shader        m_postprocessing_shader;
@@ -139,13 +159,21 @@ protected:
     vera::Texture*                  m_plot_texture;
     glm::vec4                       m_plot_values[256];
     PlotType                        m_plot;
+    HistogramPass                   m_plot_histogram;
+    HistogramSampler                m_plot_sampler;
+    std::atomic<bool>               m_plot_gpu;     // requested by plot_histogram, HistogramPass falls back to CPU if unsupported
+    bool                            m_plot_updated; // the histogram texture changed since the last frame
 
     // Recording
     vera::Fbo                       m_record_fbo;
+    ReadbackRing                    m_record_readback;
+    std::shared_ptr<PixelPool>      m_record_pool;
+    YuvPass                         m_record_yuv;
+    bool                            m_record_yuv_check;
+    RawContainer                    m_record_container;
+    int                             m_record_container_first;
     #if defined(SUPPORT_MULTITHREAD_RECORDING)
-    std::atomic<int>                m_task_count {0};
-    std::atomic<long long>          m_max_mem_in_queue {0};
-    thread_pool::ThreadPool         m_save_threads;
+    FrameSaver                      m_saver;
     #endif
 
     // Other state properties
@@ -23,13 +23,18 @@
 
 #if defined(DEBUG)
 
-#define TRACK_BEGIN(A) if (_uniforms.tracker.isRunning()) _uniforms.tracker.begin(A); 
-#define TRACK_END(A) if (_uniforms.tracker.isRunning()) _uniforms.tracker.end(A); 
+// names are interned once per call site, on its first pass. Ids resolved somewhere else go through the _ID ones
+#define TRACK_BEGIN(A) if (_uniforms.tracker.isRunning()) { static const int trackId = _uniforms.tracker.getTrackId(A); _uniforms.tracker.begin(trackId); }
+#define TRACK_END(A) if (_uniforms.tracker.isRunning()) { static const int trackId = _uniforms.tracker.getTrackId(A); _uniforms.tracker.end(trackId); }
+#define TRACK_BEGIN_ID(A) if (_uniforms.tracker.isRunning()) _uniforms.tracker.begin(A);
+#define TRACK_END_ID(A) if (_uniforms.tracker.isRunning()) _uniforms.tracker.end(A);
 
 #else 
 
 #define TRACK_BEGIN(A) 
 #define TRACK_END(A)
+#define TRACK_BEGIN_ID(A)
+#define TRACK_END_ID(A)
 
 #endif
 
@@ -459,10 +464,13 @@ bool SceneRender::loadScene(Uniforms& _uniforms) {
     vera::addLabel("u_light", _uniforms.lights["default"], vera::LABEL_DOWN, 30.0f);
     m_lightUI_shader.setSource(vera::getDefaultSrc(vera::FRAG_LIGHT), vera::getDefaultSrc(vera::VERT_LIGHT));
 
+    _updateTracks(_uniforms);
+
     return true;
 }
 
 bool SceneRender::clearScene() {
+    m_models_tracks.clear();
     m_floor.clear();
     m_floor_subd = -1;
     m_floor_height = 0.0;
@@ -569,6 +577,32 @@ void SceneRender::setShaders(Uniforms& _uniforms, const std::string& _fragmentSh
         for (int i = 0; i < devLookBillboards; i++)
             m_devlook_billboards[i]->setShader(_fragmentShader, vera::getDefaultSrc(vera::VERT_DEVLOOK_BILLBOARD));
 
+    _updateTracks(_uniforms);
+}
+
+// Track ids of every model on each pass, so tracking them doesn't build their names on each frame
+SceneRender::ModelTracks SceneRender::_trackModel(Uniforms& _uniforms, const std::string& _name) {
+    ModelTracks tracks;
+    tracks.scene = _uniforms.tracker.getTrackId("render:scene:" + _name);
+    tracks.normal = _uniforms.tracker.getTrackId("render:sceneNormal:" + _name);
+    tracks.position = _uniforms.tracker.getTrackId("render:scenePosition:" + _name);
+    tracks.shadow = _uniforms.tracker.getTrackId("render:scene:shadowmap:" + _name);
+    for (size_t i = 0; i < m_buffers_total; i++)
+        tracks.buffers.push_back( _uniforms.tracker.getTrackId("render:u_sceneBuffer" + vera::toString(i) + ":" + _name) );
+    return tracks;
+}
+
+void SceneRender::_updateTracks(Uniforms& _uniforms) {
+    m_models_tracks.clear();
+    for (vera::ModelsMap::iterator it = _uniforms.models.begin(); it != _uniforms.models.end(); ++it)
+        m_models_tracks[it->second] = _trackModel(_uniforms, it->second->getName());
+    m_floor_tracks = _trackModel(_uniforms, "floor");
+}
+
+const SceneRender::ModelTracks& SceneRender::_getTracks(const vera::Model* _model) const {
+    static const ModelTracks untracked;
+    std::unordered_map<const vera::Model*, ModelTracks>::const_iterator it = m_models_tracks.find(_model);
+    return (it != m_models_tracks.end())? it->second : untracked;
 }
 
 void SceneRender::updateBuffers(Uniforms& _uniforms, int _width, int _height) {
@@ -623,7 +657,7 @@ void SceneRender::render(Uniforms& _uniforms) {
     vera::cullingMode(m_culling);
 
     for (vera::ModelsMap::iterator it = _uniforms.models.begin(); it != _uniforms.models.end(); ++it) {
-        TRACK_BEGIN("render:scene:" + it->second->getName() )
+        TRACK_BEGIN_ID( _getTracks(it->second).scene )
 
         // bind the shader
         it->second->getShader()->use();
@@ -641,7 +675,7 @@ void SceneRender::render(Uniforms& _uniforms) {
 
         it->second->render();
 
-        TRACK_END("render:scene:" + it->second->getName() )
+        TRACK_END_ID( _getTracks(it->second).scene )
     }
 
     TRACK_BEGIN("render:scene:devlook")
@@ -677,14 +711,14 @@ void SceneRender::renderNormalBuffer(Uniforms& _uniforms) {
     if (m_floor_subd_target >= 0) {
         normalShader = m_floor.getBufferShader("normal");
         if (normalShader != nullptr) {
-            TRACK_BEGIN("render:sceneNormal:floor")
+            TRACK_BEGIN_ID( m_floor_tracks.normal )
             normalShader->use();
             _uniforms.feedTo( normalShader, false );
             normalShader->setUniform("u_modelViewProjectionMatrix", vera::projectionViewWorldMatrix() * m_floor.getTransformMatrix());
             normalShader->setUniform("u_model", m_origin.getPosition() + m_floor.getPosition() );
             normalShader->setUniform("u_modelMatrix", m_origin.getTransformMatrix() * m_floor.getTransformMatrix() );
             m_floor.render(normalShader);
-            TRACK_END("render:sceneNormal:floor")
+            TRACK_END_ID( m_floor_tracks.normal )
         } 
     }
 
@@ -693,7 +727,7 @@ void SceneRender::renderNormalBuffer(Uniforms& _uniforms) {
     for (vera::ModelsMap::iterator it = _uniforms.models.begin(); it != _uniforms.models.end(); ++it) {
         normalShader = it->second->getBufferShader("normal");
         if (normalShader != nullptr) {
-            TRACK_BEGIN("render:sceneNormal:" + it->second->getName() )
+            TRACK_BEGIN_ID( _getTracks(it->second).normal )
 
             // bind the shader
             normalShader->use();
@@ -707,7 +741,7 @@ void SceneRender::renderNormalBuffer(Uniforms& _uniforms) {
             normalShader->setUniform( "u_modelMatrix", m_origin.getTransformMatrix() * it->second->getTransformMatrix() );
             it->second->render(normalShader);
 
-            TRACK_END("render:sceneNormal:" + it->second->getName() )
+            TRACK_END_ID( _getTracks(it->second).normal )
         }
     }
 
@@ -739,14 +773,14 @@ void SceneRender::renderPositionBuffer(Uniforms& _uniforms) {
     if (m_floor_subd_target >= 0) {
         positionShader = m_floor.getBufferShader("position");
         if (positionShader != nullptr) {
-            TRACK_BEGIN("render:scenePosition:floor")
+            TRACK_BEGIN_ID( m_floor_tracks.position )
             positionShader->use();
             _uniforms.feedTo( positionShader, false );
             positionShader->setUniform("u_modelViewProjectionMatrix", vera::projectionViewWorldMatrix() *  m_floor.getTransformMatrix() );
             positionShader->setUniform("u_model", m_origin.getPosition() + m_floor.getPosition() );
             positionShader->setUniform("u_modelMatrix", m_origin.getTransformMatrix() * m_floor.getTransformMatrix() );
             m_floor.render(positionShader);
-            TRACK_END("render:scenePosition:floor")
+            TRACK_END_ID( m_floor_tracks.position )
         } 
     }
 
@@ -755,7 +789,7 @@ void SceneRender::renderPositionBuffer(Uniforms& _uniforms) {
     for (vera::ModelsMap::iterator it = _uniforms.models.begin(); it != _uniforms.models.end(); ++it) {
         positionShader = it->second->getBufferShader("position");
         if (positionShader != nullptr) {
-            TRACK_BEGIN("render:scenePosition:" + it->second->getName() )
+            TRACK_BEGIN_ID( _getTracks(it->second).position )
 
             // bind the shader
             positionShader->use();
@@ -769,7 +803,7 @@ void SceneRender::renderPositionBuffer(Uniforms& _uniforms) {
             positionShader->setUniform( "u_modelMatrix", m_origin.getTransformMatrix() * it->second->getTransformMatrix() );
             it->second->render(positionShader);
 
-            TRACK_END("render:scenePosition:" + it->second->getName() )
+            TRACK_END_ID( _getTracks(it->second).position )
         }
     }
 
@@ -818,14 +852,14 @@ void SceneRender::renderBuffers(Uniforms& _uniforms) {
         if (m_floor_subd_target >= 0) {
             bufferShader = m_floor.getBufferShader(bufferName);
             if (bufferShader != nullptr) {
-                    TRACK_BEGIN("render:"+bufferName+":floor")
+                    TRACK_BEGIN_ID( m_floor_tracks.getBuffer(i) )
                     bufferShader->use();
                     _uniforms.feedTo( bufferShader, false );
                     bufferShader->setUniform( "u_modelViewProjectionMatrix", vera::projectionViewWorldMatrix() * m_floor.getTransformMatrix() );
                     bufferShader->setUniform( "u_model", m_origin.getPosition() + m_floor.getPosition() );
                     bufferShader->setUniform( "u_modelMatrix", m_origin.getTransformMatrix() * m_floor.getTransformMatrix() );
                     m_floor.render(bufferShader);
-                    TRACK_END("render:"+bufferName+":floor")
+                    TRACK_END_ID( m_floor_tracks.getBuffer(i) )
                 }
         }
 
@@ -835,7 +869,7 @@ void SceneRender::renderBuffers(Uniforms& _uniforms) {
             bufferShader = it->second->getBufferShader(bufferName);
 
             if (bufferShader != nullptr) {
-                TRACK_BEGIN("render:" + bufferName + ":" + it->second->getName())
+                TRACK_BEGIN_ID( _getTracks(it->second).getBuffer(i) )
 
                 // bind the shader
                 bufferShader->use();
@@ -849,7 +883,7 @@ void SceneRender::renderBuffers(Uniforms& _uniforms) {
                 bufferShader->setUniform( "u_modelMatrix", m_origin.getTransformMatrix() * it->second->getTransformMatrix() );
                 it->second->render(bufferShader);
 
-                TRACK_END("render:" + bufferName + ":" + it->second->getName())
+                TRACK_END_ID( _getTracks(it->second).getBuffer(i) )
             }
         }
 
@@ -880,7 +914,7 @@ void SceneRender::renderShadowMap(Uniforms& _uniforms) {
 
             shadowShader = m_floor.getBufferShader("shadow");
             if (m_floor.getVbo() && shadowShader != nullptr) {
-                TRACK_BEGIN("render:scene:shadowmap:floor")
+                TRACK_BEGIN_ID( m_floor_tracks.shadow )
                 shadowShader->use();
                 _uniforms.feedTo( shadowShader, false );
                 shadowShader->setUniform( "u_modelViewProjectionMatrix", lit->second->getMVPMatrix( m_origin.getTransformMatrix() * m_floor.getTransformMatrix(), m_area ) );
@@ -889,13 +923,13 @@ void SceneRender::renderShadowMap(Uniforms& _uniforms) {
                 shadowShader->setUniform( "u_modelMatrix", m_origin.getTransformMatrix() * m_floor.getTransformMatrix() );
                 shadowShader->setUniform( "u_model", m_origin.getPosition() + m_floor.getPosition() );
                 m_floor.render(shadowShader);
-                TRACK_END("render:scene:shadowmap:floor")
+                TRACK_END_ID( m_floor_tracks.shadow )
             }
 
             for (vera::ModelsMap::iterator mit = _uniforms.models.begin(); mit != _uniforms.models.end(); ++mit) {
                 shadowShader = mit->second->getBufferShader("shadow");
                 if (shadowShader != nullptr) {
-                    TRACK_BEGIN("render:scene:shadowmap:" + mit->second->getName())
+                    TRACK_BEGIN_ID( _getTracks(mit->second).shadow )
 
                     // bind the shader
                     shadowShader->use();
@@ -911,7 +945,7 @@ void SceneRender::renderShadowMap(Uniforms& _uniforms) {
                     shadowShader->setUniform( "u_model", m_origin.getPosition() + mit->second->getPosition() );
                     mit->second->render(shadowShader);
 
-                    TRACK_END("render:scene:shadowmap:" + mit->second->getName())
+                    TRACK_END_ID( _getTracks(mit->second).shadow )
                 }
             }
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <memory>
+#include <unordered_map>
 #include "uniforms.h"
 #include "tools/command.h"
 
@@ -104,6 +105,24 @@ protected:
 
     size_t                      m_buffers_total;
 
+    // Track ids of a model on each pass, resolved when models or shaders load
+    struct ModelTracks {
+        ModelTracks() : scene(-1), normal(-1), position(-1), shadow(-1) {}
+        int                 getBuffer(size_t _index) const { return (_index < buffers.size())? buffers[_index] : -1; }
+
+        int                 scene;
+        int                 normal;
+        int                 position;
+        int                 shadow;
+        std::vector<int>    buffers;
+    };
+    ModelTracks                 _trackModel(Uniforms& _uniforms, const std::string& _name);
+    void                        _updateTracks(Uniforms& _uniforms);
+    const ModelTracks&          _getTracks(const vera::Model* _model) const;
+
+    std::unordered_map<const vera::Model*, ModelTracks> m_models_tracks;
+    ModelTracks                 m_floor_tracks;
+
     bool                        m_commands_loaded;
     bool                        m_uniforms_loaded;
 };
@@ -2,6 +2,8 @@
 
 #include <vector>
 #include <string>
+#include <utility>
+#include <algorithm>
 #include <functional>
 
 struct Command {
@@ -23,3 +25,71 @@ struct Command {
 };
 
 typedef std::vector<Command> CommandList;
+
+/** Finds the commands whose trigger is a prefix of a line without comparing it against every one
+ *  of them. Triggers are kept on a trie, so a lookup costs the length of the longest matching
+ *  trigger, and matches come back in the order the commands were added, as the linear scan did **/
+class CommandIndex {
+public:
+    void    build(const CommandList& _commands) {
+        m_nodes.clear();
+        m_nodes.push_back(Node());
+        for (size_t i = 0; i < _commands.size(); i++) {
+            size_t node = 0;
+            for (size_t c = 0; c < _commands[i].trigger.size(); c++)
+                node = _insert(node, _commands[i].trigger[c]);
+            m_nodes[node].commands.push_back(i);
+        }
+        m_total = _commands.size();
+    }
+
+    /** Commands indexed by the last build() **/
+    size_t  size() const { return m_total; }
+
+    /** Writes on _matches the indices of the commands which trigger _line begins with **/
+    void    match(const std::string& _line, std::vector<size_t>& _matches) const {
+        _matches.clear();
+        if (m_nodes.empty())
+            return;
+
+        size_t node = 0;
+        for (size_t c = 0; c < _line.size() && node != NONE; c++) {
+            node = _child(node, _line[c]);
+            if (node != NONE)
+                _matches.insert(_matches.end(), m_nodes[node].commands.begin(), m_nodes[node].commands.end());
+        }
+
+        // longer triggers are found later but may have been added first
+        std::sort(_matches.begin(), _matches.end());
+    }
+
+private:
+    static const size_t NONE = (size_t)-1;
+
+    struct Node {
+        std::vector< std::pair<char, size_t> >  children;
+        std::vector<size_t>                     commands;   // the ones which trigger ends here
+    };
+
+    size_t  _child(size_t _node, char _c) const {
+        const std::vector< std::pair<char, size_t> >& children = m_nodes[_node].children;
+        for (size_t i = 0; i < children.size(); i++)
+            if (children[i].first == _c)
+                return children[i].second;
+        return NONE;
+    }
+
+    size_t  _insert(size_t _node, char _c) {
+        size_t child = _child(_node, _c);
+        if (child != NONE)
+            return child;
+
+        child = m_nodes.size();
+        m_nodes.push_back(Node());
+        m_nodes[_node].children.push_back( std::make_pair(_c, child) );
+        return child;
+    }
+
+    std::vector<Node>   m_nodes;
+    size_t              m_total = 0;
+};
@@ -172,7 +172,7 @@ void refresh_stt_win() {
     uniforms_starts_at = y;
     int i = 0;
     for (UniformDataMap::iterator it= uniforms->data.begin(); it != uniforms->data.end(); ++it) {
-        if (it->second.size > 4)
+        if (it->second.size == 0 || it->second.size > 4)
             continue;
 
         mvwprintw(stt_win, y, stt_x, "%23s", it->first.c_str());
@@ -0,0 +1,227 @@
+#include "encoder.h"
+
+#if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
+
+#include <chrono>
+#include <cstring>
+#include <iostream>
+
+extern "C" {
+#include <libavcodec/avcodec.h>
+#include <libavformat/avformat.h>
+#include <libavutil/imgutils.h>
+#include <libavutil/opt.h>
+}
+
+#include "yuv.h"
+
+Encoder::Encoder() :
+    m_format(nullptr), m_codec(nullptr), m_stream(nullptr), m_frame(nullptr), m_packet(nullptr),
+    m_srcWidth(0), m_width(0), m_height(0), m_pts(0),
+    m_frames(0), m_latencyTotal(0.0), m_latencyMax(0.0), m_latencyLast(0.0) {
+}
+
+Encoder::~Encoder() {
+    close();
+}
+
+bool Encoder::open(const std::string& _path, int _width, int _height, float _fps, int _crf) {
+    close();
+
+    m_path = _path;
+    m_srcWidth = _width;
+    // YUV 4:2:0 needs even dimensions
+    m_width = _width - (_width % 2);
+    m_height = _height - (_height % 2);
+    m_pts = 0;
+    m_frames = 0;
+    m_latencyTotal = 0.0;
+    m_latencyMax = 0.0;
+    m_latencyLast = 0.0;
+
+    if (m_width <= 0 || m_height <= 0)
+        return false;
+
+    if (avformat_alloc_output_context2(&m_format, NULL, NULL, m_path.c_str()) < 0 || !m_format) {
+        std::cerr << "Encoder: can't guess the container of " << m_path << std::endl;
+        return false;
+    }
+
+    const AVCodec* codec = avcodec_find_encoder_by_name("libx264");
+    if (!codec)
+        codec = avcodec_find_encoder(AV_CODEC_ID_H264);
+    if (!codec) {
+        std::cerr << "Encoder: no H.264 encoder available" << std::endl;
+        close();
+        return false;
+    }
+
+    m_stream = avformat_new_stream(m_format, NULL);
+    m_codec = avcodec_alloc_context3(codec);
+    if (!m_stream || !m_codec) {
+        close();
+        return false;
+    }
+
+    AVRational fps = av_d2q(_fps, 1000);
+    m_codec->width = m_width;
+    m_codec->height = m_height;
+    m_codec->pix_fmt = AV_PIX_FMT_YUV420P;
+    m_codec->framerate = fps;
+    m_codec->time_base = av_inv_q(fps);
+    m_codec->gop_size = 1;
+    m_stream->time_base = m_codec->time_base;
+
+    if (m_format->oformat->flags & AVFMT_GLOBALHEADER)
+        m_codec->flags |= AV_CODEC_FLAG_GLOBAL_HEADER;
+
+    if (m_codec->priv_data) {
+        av_opt_set(m_codec->priv_data, "crf", std::to_string(_crf).c_str(), 0);
+        av_opt_set(m_codec->priv_data, "preset", "veryfast", 0);
+    }
+
+    if (avcodec_open2(m_codec, codec, NULL) < 0) {
+        std::cerr << "Encoder: can't open " << codec->name << std::endl;
+        close();
+        return false;
+    }
+
+    if (avcodec_parameters_from_context(m_stream->codecpar, m_codec) < 0) {
+        close();
+        return false;
+    }
+
+    if ( !(m_format->oformat->flags & AVFMT_NOFILE) ) {
+        if (avio_open(&m_format->pb, m_path.c_str(), AVIO_FLAG_WRITE) < 0) {
+            std::cerr << "Encoder: can't open " << m_path << " for writing" << std::endl;
+            close();
+            return false;
+        }
+    }
+
+    if (avformat_write_header(m_format, NULL) < 0) {
+        std::cerr << "Encoder: can't write the header of " << m_path << std::endl;
+        close();
+        return false;
+    }
+
+    m_frame = av_frame_alloc();
+    m_packet = av_packet_alloc();
+    if (!m_frame || !m_packet) {
+        close();
+        return false;
+    }
+
+    m_frame->format = m_codec->pix_fmt;
+    m_frame->width = m_width;
+    m_frame->height = m_height;
+    if (av_frame_get_buffer(m_frame, 32) < 0) {
+        close();
+        return false;
+    }
+
+    return true;
+}
+
+bool Encoder::encode(const unsigned char* _rgba) {
+    if (!isOpen())
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (av_frame_make_writable(m_frame) < 0)
+        return false;
+
+    rgbaToYuv420(   _rgba, (size_t)m_srcWidth * 4, m_width, m_height, true,
+                    m_frame->data[0], m_frame->linesize[0],
+                    m_frame->data[1], m_frame->linesize[1],
+                    m_frame->data[2], m_frame->linesize[2] );
+
+    m_frame->pts = m_pts++;
+    bool rta = _send(m_frame);
+
+    _addLatency( std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() );
+    return rta;
+}
+
+bool Encoder::encodeYuv(const unsigned char* _yuv) {
+    if (!isOpen())
+        return false;
+
+    auto start = std::chrono::steady_clock::now();
+
+    if (av_frame_make_writable(m_frame) < 0)
+        return false;
+
+    const unsigned char* src[4] = { _yuv, _yuv + m_width * m_height, _yuv + m_width * m_height + (m_width/2) * (m_height/2), NULL };
+    const int srcStride[4] = { m_width, m_width/2, m_width/2, 0 };
+    av_image_copy(m_frame->data, m_frame->linesize, src, srcStride, AV_PIX_FMT_YUV420P, m_width, m_height);
+
+    m_frame->pts = m_pts++;
+    bool rta = _send(m_frame);
+
+    _addLatency( std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count() );
+    return rta;
+}
+
+bool Encoder::_send(AVFrame* _frame) {
+    if (avcodec_send_frame(m_codec, _frame) < 0) {
+        std::cerr << "Encoder: error sending frame " << m_pts << std::endl;
+        return false;
+    }
+
+    while (true) {
+        int err = avcodec_receive_packet(m_codec, m_packet);
+        if (err == AVERROR(EAGAIN) || err == AVERROR_EOF)
+            break;
+        else if (err < 0) {
+            std::cerr << "Encoder: error encoding frame " << m_pts << std::endl;
+            return false;
+        }
+
+        av_packet_rescale_ts(m_packet, m_codec->time_base, m_stream->time_base);
+        m_packet->stream_index = m_stream->index;
+        av_interleaved_write_frame(m_format, m_packet);
+        av_packet_unref(m_packet);
+    }
+
+    return true;
+}
+
+void Encoder::_addLatency(double _ms) {
+    m_frames++;
+    m_latencyLast = _ms;
+    m_latencyTotal += _ms;
+    if (_ms > m_latencyMax)
+        m_latencyMax = _ms;
+}
+
+void Encoder::close() {
+    // flush the frames the encoder is still holding
+    if (m_codec && m_format && m_packet && m_frame) {
+        _send(NULL);
+        av_write_trailer(m_format);
+    }
+
+    if (m_format && m_format->pb && !(m_format->oformat->flags & AVFMT_NOFILE))
+        avio_closep(&m_format->pb);
+
+    if (m_codec)
+        avcodec_free_context(&m_codec);
+
+    if (m_frame)
+        av_frame_free(&m_frame);
+
+    if (m_packet)
+        av_packet_free(&m_packet);
+
+    if (m_format) {
+        avformat_free_context(m_format);
+        m_format = nullptr;
+    }
+
+    m_codec = nullptr;
+    m_stream = nullptr;
+}
+
+#endif
@@ -0,0 +1,58 @@
+#pragma once
+
+#if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
+
+#include <string>
+#include <vector>
+
+struct AVFormatContext;
+struct AVCodecContext;
+struct AVStream;
+struct AVFrame;
+struct AVPacket;
+
+/** In-process H.264 encoder built directly on top of libavcodec/libavformat.
+ *  It takes the RGBA frames as they come from glReadPixels (bottom-up), converts them
+ *  to YUV 4:2:0 and muxes them into _path. Call it from one thread only (the recording one). **/
+class Encoder {
+public:
+    Encoder();
+    virtual ~Encoder();
+
+    bool    open(const std::string& _path, int _width, int _height, float _fps, int _crf = 10);
+    bool    isOpen() const { return m_codec != nullptr; }
+    void    close();
+
+    /** _rgba has _width * _height * 4 bytes, as read by glReadPixels **/
+    bool    encode(const unsigned char* _rgba);
+    /** _yuv is already planar YUV 4:2:0, top-down, with no padding between planes **/
+    bool    encodeYuv(const unsigned char* _yuv);
+
+    size_t  getFrames() const { return m_frames; }
+    double  getLatencyAverage() const { return m_frames > 0 ? m_latencyTotal / m_frames : 0.0; }
+    double  getLatencyMax() const { return m_latencyMax; }
+    double  getLatencyLast() const { return m_latencyLast; }
+
+protected:
+    bool    _send(AVFrame* _frame);
+    void    _addLatency(double _ms);
+
+    AVFormatContext*    m_format;
+    AVCodecContext*     m_codec;
+    AVStream*           m_stream;
+    AVFrame*            m_frame;
+    AVPacket*           m_packet;
+
+    std::string         m_path;
+    int                 m_srcWidth;
+    int                 m_width;
+    int                 m_height;
+    long long           m_pts;
+
+    size_t              m_frames;
+    double              m_latencyTotal;
+    double              m_latencyMax;
+    double              m_latencyLast;
+};
+
+#endif
@@ -0,0 +1,251 @@
+#include "frameSaver.h"
+
+#if defined(SUPPORT_MULTITHREAD_RECORDING)
+
+#include <cmath>
+#include <iostream>
+
+#include "vera/ops/fs.h"
+
+// Global of the stb_image_write implementation compiled inside vera, read by every PNG encode. It's
+// only written under the saver lock while no PNG is being encoded, so a change waits for the ones in
+// flight and then applies to the next frames.
+extern "C" int stbi_write_png_compression_level;
+
+#define PNG_DEFAULT_LEVEL   8   // stb_image_write default
+#define PNG_FASTEST_LEVEL   1
+#define CALM_FRAMES         32  // frames without stalls before raising the automatic level back
+#define IDLE_MS             2000    // workers beyond the active ones exit after being idle this long
+
+FrameSaver::FrameSaver(size_t _maxThreads, long long _maxMemory) :
+    m_active(1), m_maxThreads(std::max((size_t)1, _maxThreads)), m_running(true),
+    m_pending(0), m_memoryLeft(_maxMemory), m_maxMemory(_maxMemory),
+    m_intervalMs(0.0), m_haveSubmit(false), m_stalls(0),
+    m_tracker(nullptr), m_trackSave(-1), m_trackQueue(-1), m_trackMemory(-1),
+    m_pngLevel(-1), m_autoLevel(PNG_DEFAULT_LEVEL), m_pngCurrent(stbi_write_png_compression_level), m_pngEncoding(0),
+    m_calmFrames(0) {
+}
+
+FrameSaver::~FrameSaver() {
+    flush();
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_running = false;
+    lock.unlock();
+    m_work.notify_all();
+
+    for (size_t i = 0; i < m_threads.size(); i++)
+        m_threads[i].join();
+    for (size_t i = 0; i < m_retired.size(); i++)
+        m_retired[i].join();
+}
+
+void FrameSaver::submit(const std::string& _file, int _width, int _height, Pixels&& _pixels) {
+    std::string ext = vera::getExt(_file);
+    long long bytes = (long long)_width * _height * 4;
+
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    auto now = std::chrono::steady_clock::now();
+    if (m_haveSubmit) {
+        double ms = std::chrono::duration<double, std::milli>(now - m_lastSubmit).count();
+        m_intervalMs = (m_intervalMs > 0.0)? m_intervalMs * 0.9 + ms * 0.1 : ms;
+    }
+    m_lastSubmit = now;
+    m_haveSubmit = true;
+
+    // Backpressure: wait for the workers instead of encoding on the caller thread.
+    // A frame bigger than the whole budget still goes through once the queue is empty
+    if (m_memoryLeft.load() < bytes && m_pending.load() > 0) {
+        m_stalls++;
+        m_calmFrames = 0;
+        if (m_pngLevel < 0 && ext == "png" && m_autoLevel > PNG_FASTEST_LEVEL)
+            m_autoLevel--;
+
+        _schedule(ext);
+        m_space.wait(lock, [&]() { return m_memoryLeft.load() >= bytes || m_pending.load() == 0; });
+    }
+    else if (m_pngLevel < 0 && ext == "png" && ++m_calmFrames >= CALM_FRAMES) {
+        m_calmFrames = 0;
+        if (m_autoLevel < PNG_DEFAULT_LEVEL)
+            m_autoLevel++;
+    }
+
+    m_queue.push_back( Task{ext, Job(_file, _width, _height, std::move(_pixels), m_pending, m_memoryLeft)} );
+    _schedule(ext);
+    _count();
+    lock.unlock();
+
+    m_work.notify_all();
+}
+
+// Wakes up as many workers as the average encode time of the format needs to keep the pace
+// of the incoming frames, plus one if the queue is still growing. Needs the lock
+void FrameSaver::_schedule(const std::string& _ext) {
+    size_t needed = 1;
+    auto it = m_encodeMs.find(_ext);
+    if (it != m_encodeMs.end() && m_intervalMs > 0.0)
+        needed = (size_t)std::ceil(it->second / m_intervalMs);
+    else
+        needed = m_active;
+
+    if (m_queue.size() > m_active)
+        needed = std::max(needed, m_active + 1);
+
+    m_active = std::min(std::max(needed, (size_t)1), m_maxThreads);
+
+    // they are past the lock already, just returning
+    for (size_t i = 0; i < m_retired.size(); i++)
+        m_retired[i].join();
+    m_retired.clear();
+
+    while (m_threads.size() < m_active)
+        m_threads.push_back( std::thread(&FrameSaver::_work, this, m_threads.size()) );
+}
+
+void FrameSaver::setTracker(Tracker* _tracker) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_tracker = _tracker;
+    m_trackSave = _tracker->getTrackId("saver:save");
+    m_trackQueue = _tracker->getTrackId("saver:queue");
+    m_trackMemory = _tracker->getTrackId("saver:memoryMB");
+}
+
+// Queue depth and memory held by it, under the saver lock
+void FrameSaver::_count() {
+    if (m_tracker == nullptr || !m_tracker->isRunning())
+        return;
+
+    m_tracker->counter(m_trackQueue, (double)getPending());
+    m_tracker->counter(m_trackMemory, (double)(m_maxMemory - m_memoryLeft.load()) / (1024.0 * 1024.0));
+}
+
+void FrameSaver::_work(size_t _index) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    if (m_tracker != nullptr)
+        m_tracker->setThreadName("saver " + std::to_string(_index));
+
+    while (true) {
+        // workers beyond the active count stay parked
+        bool ready = m_work.wait_for(lock, std::chrono::milliseconds(IDLE_MS), [&]() { return !m_running || (_index < m_active && !m_queue.empty() && _canTake()); });
+        if (!m_running)
+            break;
+
+        if (!ready) {
+            // the pool shrinks from the last worker, the others follow once they are the last.
+            // The first one stays
+            if (_index > 0 && _index + 1 == m_threads.size() && (_index >= m_active || m_queue.empty())) {
+                m_active = std::min(m_active, _index);
+                m_retired.push_back( std::move(m_threads.back()) );
+                m_threads.pop_back();
+                break;
+            }
+            continue;
+        }
+
+        Task task = std::move(m_queue.front());
+        m_queue.pop_front();
+
+        bool png = task.ext == "png";
+        if (png) {
+            if (m_pngEncoding == 0) {
+                m_pngCurrent = (m_pngLevel < 0)? m_autoLevel : m_pngLevel;
+                stbi_write_png_compression_level = m_pngCurrent;
+            }
+            m_pngEncoding++;
+        }
+
+        lock.unlock();
+        StatPoint start = StatClock::now();
+        task.job();
+        StatPoint end = StatClock::now();
+        double ms = std::chrono::duration<double, std::milli>(end - start).count();
+        lock.lock();
+
+        // the level may be waiting for the PNGs in flight to change
+        if (png && --m_pngEncoding == 0)
+            m_work.notify_all();
+
+        if (m_tracker != nullptr && m_tracker->isRunning()) {
+            m_tracker->record(m_trackSave, start, end);
+            _count();
+        }
+
+        auto it = m_encodeMs.find(task.ext);
+        if (it == m_encodeMs.end())
+            m_encodeMs[task.ext] = ms;
+        else
+            it->second = it->second * 0.9 + ms * 0.1;
+
+        m_space.notify_all();
+        m_done.notify_all();
+    }
+}
+
+// A PNG at the front of the queue waits while others are encoded at a level that isn't its. Needs the lock
+bool FrameSaver::_canTake() {
+    if (m_queue.front().ext != "png" || m_pngEncoding == 0)
+        return true;
+    return m_pngCurrent == ((m_pngLevel < 0)? m_autoLevel : m_pngLevel);
+}
+
+void FrameSaver::flush() {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_done.wait(lock, [&]() { return m_queue.empty() && m_pending.load() <= 0; });
+}
+
+size_t FrameSaver::getActiveThreads() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_active;
+}
+
+void FrameSaver::setMaxThreads(size_t _maxThreads) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_maxThreads = std::max((size_t)1, _maxThreads);
+    m_active = std::min(m_active, m_maxThreads);
+    lock.unlock();
+    m_work.notify_all();
+}
+
+void FrameSaver::setMaxMemory(long long _bytes) {
+    std::unique_lock<std::mutex> lock(m_mutex);
+    m_memoryLeft += _bytes - m_maxMemory;
+    m_maxMemory = _bytes;
+    lock.unlock();
+    m_space.notify_all();
+}
+
+void FrameSaver::setPngCompression(int _level) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_pngLevel = (_level < 0)? -1 : std::min(_level, 9);
+    m_autoLevel = PNG_DEFAULT_LEVEL;
+    m_calmFrames = 0;
+}
+
+int FrameSaver::getPngCompression() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pngLevel;
+}
+
+double FrameSaver::getEncodeMs(const std::string& _ext) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_encodeMs.find(_ext);
+    return (it != m_encodeMs.end())? it->second : 0.0;
+}
+
+void FrameSaver::printStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::cout << "threads: " << m_active << " active of " << m_maxThreads << " (" << m_threads.size() << " started)" << std::endl;
+    std::cout << "pending: " << m_pending.load() << " frames, " << m_stalls << " stalls" << std::endl;
+    std::cout << "frame interval: " << m_intervalMs << "ms" << std::endl;
+    for (std::map<std::string, double>::iterator it = m_encodeMs.begin(); it != m_encodeMs.end(); ++it)
+        std::cout << it->first << ": " << it->second << "ms per frame" << std::endl;
+
+    std::cout << "png compression: ";
+    if (m_pngLevel < 0)
+        std::cout << "auto (" << m_autoLevel << ")" << std::endl;
+    else
+        std::cout << m_pngLevel << std::endl;
+}
+
+#endif
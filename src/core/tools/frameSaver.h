@@ -0,0 +1,99 @@
+#pragma once
+
+#if defined(SUPPORT_MULTITHREAD_RECORDING)
+
+#include <map>
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+#include <condition_variable>
+
+#include "job.h"
+#include "tracker.h"
+
+/** Saves frames to disk on a pool of threads that grows and shrinks with the load.
+ *  It keeps an average of how long each format takes to encode and of the rate at which frames
+ *  arrive, and only wakes up as many workers as needed to keep up; the ones left idle for a while exit. When the memory budget is
+ *  exhausted submit() blocks the caller until a frame is done, instead of saving it on its thread.
+ *  With the automatic PNG compression, stalls lower the zlib level and calm periods raise it back. **/
+class FrameSaver {
+public:
+    FrameSaver(size_t _maxThreads, long long _maxMemory);
+    virtual ~FrameSaver();
+
+    void        submit(const std::string& _file, int _width, int _height, Pixels&& _pixels);
+    /** blocks until every submitted frame is on disk **/
+    void        flush();
+
+    size_t      getPending() const { return (size_t)std::max(0, m_pending.load()); }
+    size_t      getActiveThreads();
+    size_t      getMaxThreads() const { return m_maxThreads; }
+    void        setMaxThreads(size_t _maxThreads);
+
+    long long   getMaxMemory() const { return m_maxMemory; }
+    void        setMaxMemory(long long _bytes);
+
+    /** -1 for automatic, otherwise a zlib level from 0 (fast, big) to 9 (slow, small) **/
+    void        setPngCompression(int _level);
+    int         getPngCompression();
+
+    double      getEncodeMs(const std::string& _ext);
+    void        printStats();
+
+    /** Adds the saves of each worker and the size of the queue to _tracker while it runs **/
+    void        setTracker(Tracker* _tracker);
+
+protected:
+    struct Task {
+        std::string ext;
+        Job         job;
+    };
+
+    void        _work(size_t _index);
+    void        _schedule(const std::string& _ext);
+    void        _count();
+    bool        _canTake();
+
+    std::mutex                      m_mutex;
+    std::condition_variable         m_work;
+    std::condition_variable         m_space;
+    std::condition_variable         m_done;
+
+    std::deque<Task>                m_queue;
+    std::vector<std::thread>        m_threads;
+    std::vector<std::thread>        m_retired;  // idle workers that left, to join
+    size_t                          m_active;
+    size_t                          m_maxThreads;
+    bool                            m_running;
+
+    std::atomic<int>                m_pending;
+    std::atomic<long long>          m_memoryLeft;
+    long long                       m_maxMemory;
+
+    // timing
+    std::map<std::string, double>   m_encodeMs;
+    double                          m_intervalMs;
+    std::chrono::steady_clock::time_point m_lastSubmit;
+    bool                            m_haveSubmit;
+    size_t                          m_stalls;
+
+    // tracking
+    Tracker*                        m_tracker;
+    int                             m_trackSave;
+    int                             m_trackQueue;
+    int                             m_trackMemory;
+
+    // png compression
+    int                             m_pngLevel;
+    int                             m_autoLevel;
+    int                             m_pngCurrent;   // on stbi_write_png_compression_level
+    size_t                          m_pngEncoding;  // PNGs being encoded right now
+    size_t                          m_calmFrames;
+};
+
+#endif
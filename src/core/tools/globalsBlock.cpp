@@ -0,0 +1,120 @@
+#include "globalsBlock.h"
+
+#include <set>
+#include <cstring>
+#include <iostream>
+
+static_assert(sizeof(GlobalsData) == 368, "GlobalsData doesn't match the std140 layout of GlslViewerGlobals");
+
+GlobalsBlock::GlobalsBlock() : m_buffer(0), m_enabled(false), m_dirty(true) {
+    for (size_t i = 0; i < 9; i++)
+        data.SH[i] = glm::vec4(0.0f);
+}
+
+GlobalsBlock::~GlobalsBlock() {
+    _clear();
+}
+
+const std::string& GlobalsBlock::getSource() {
+    static const std::string source =
+        "layout(std140) uniform GlslViewerGlobals { "
+            "vec4 u_date; vec2 u_resolution; vec2 u_mouse; "
+            "float u_time; float u_delta; float u_pixelDensity; int u_frame; "
+            "vec3 u_camera; float u_cameraDistance; vec3 u_cameraTarget; float u_cameraNearClip; "
+            "float u_cameraFarClip; float u_cameraEv100; float u_cameraExposure; float u_cameraAperture; "
+            "float u_cameraShutterSpeed; float u_cameraSensitivity; float u_iblLuminance; int u_play; "
+            "vec3 u_light; float u_lightIntensity; vec3 u_lightColor; float u_lightFalloff; "
+            "vec3 u_lightDirection; float u_globalsPadding; mat4 u_lightMatrix; "
+            "vec3 u_SH[9]; "
+        "};";
+    return source;
+}
+
+bool GlobalsBlock::has(const std::string& _uniform) {
+    static const std::set<std::string> members = {
+        "u_date", "u_resolution", "u_mouse", "u_time", "u_delta", "u_pixelDensity", "u_frame",
+        "u_camera", "u_cameraDistance", "u_cameraTarget", "u_cameraNearClip", "u_cameraFarClip",
+        "u_cameraEv100", "u_cameraExposure", "u_cameraAperture", "u_cameraShutterSpeed",
+        "u_cameraSensitivity", "u_iblLuminance", "u_play", "u_light", "u_lightIntensity",
+        "u_lightColor", "u_lightFalloff", "u_lightDirection", "u_lightMatrix", "u_SH" };
+    return members.find(_uniform) != members.end();
+}
+
+void GlobalsBlock::_clear() {
+    #if defined(SUPPORT_UNIFORM_BUFFER)
+    if (m_buffer)
+        glDeleteBuffers(1, &m_buffer);
+    #endif
+    m_buffer = 0;
+    m_dirty = true;
+    m_programs.clear();
+}
+
+bool GlobalsBlock::upload() {
+    if (!m_enabled) {
+        if (m_buffer)
+            _clear();
+        return true;
+    }
+
+    #if defined(SUPPORT_UNIFORM_BUFFER)
+    if (m_buffer == 0) {
+        // the headers may have them while the context doesn't, then the query leaves it untouched
+        GLint bindings = 0;
+        glGetIntegerv(GL_MAX_UNIFORM_BUFFER_BINDINGS, &bindings);
+        if (bindings <= GLOBALS_BLOCK_BINDING) {
+            std::cout << "Uniform buffers are not supported by this context" << std::endl;
+            m_enabled = false;
+            return false;
+        }
+
+        glGenBuffers(1, &m_buffer);
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+        glBufferData(GL_UNIFORM_BUFFER, sizeof(GlobalsData), NULL, GL_DYNAMIC_DRAW);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        m_dirty = true;
+    }
+
+    if (m_dirty || std::memcmp(&data, &m_uploaded, sizeof(GlobalsData)) != 0) {
+        glBindBuffer(GL_UNIFORM_BUFFER, m_buffer);
+        glBufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(GlobalsData), &data);
+        glBindBuffer(GL_UNIFORM_BUFFER, 0);
+        m_uploaded = data;
+        m_dirty = false;
+    }
+
+    // cheap, and keeps it bound even if something else took the binding point
+    glBindBufferBase(GL_UNIFORM_BUFFER, GLOBALS_BLOCK_BINDING, m_buffer);
+    return true;
+
+    #else
+    std::cout << "Uniform buffers are not supported on this platform" << std::endl;
+    m_enabled = false;
+    return false;
+    #endif
+}
+
+bool GlobalsBlock::bind(vera::Shader* _shader) {
+    if (!m_enabled || m_buffer == 0)
+        return false;
+
+    #if defined(SUPPORT_UNIFORM_BUFFER)
+    unsigned int program = _shader->getProgram();
+    if (program == 0)
+        return false;
+
+    std::map<unsigned int, bool>::iterator it = m_programs.find(program);
+    if (it != m_programs.end())
+        return it->second;
+
+    GLuint index = glGetUniformBlockIndex(program, "GlslViewerGlobals");
+    bool found = index != GL_INVALID_INDEX;
+    if (found)
+        glUniformBlockBinding(program, index, GLOBALS_BLOCK_BINDING);
+
+    m_programs[program] = found;
+    return found;
+    #else
+    return false;
+    #endif
+}
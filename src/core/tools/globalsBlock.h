@@ -0,0 +1,92 @@
+#pragma once
+
+#include <map>
+#include <string>
+
+#include "glm/glm.hpp"
+#include "vera/gl/gl.h"
+#include "vera/gl/shader.h"
+
+// Uniform buffers are only present on GL 3.1 / GLES 3.0 (WebGL2) headers
+#if defined(GL_UNIFORM_BUFFER)
+#define SUPPORT_UNIFORM_BUFFER
+#endif
+
+// Binding point shared by every program that declares the block
+#define GLOBALS_BLOCK_BINDING 0
+
+/** CPU copy of the GlslViewerGlobals block, laid out as std140: vec3s are padded to 16 bytes
+ *  by the scalar that follows them and each element of an array takes a whole vec4 **/
+struct GlobalsData {
+    glm::vec4   date                = glm::vec4(0.0f);
+    glm::vec2   resolution          = glm::vec2(0.0f);
+    glm::vec2   mouse               = glm::vec2(0.0f);
+    float       time                = 0.0f;
+    float       delta               = 0.0f;
+    float       pixelDensity        = 1.0f;
+    int         frame               = 0;
+
+    glm::vec3   camera              = glm::vec3(0.0f);
+    float       cameraDistance      = 0.0f;
+    glm::vec3   cameraTarget        = glm::vec3(0.0f);
+    float       cameraNearClip      = 0.0f;
+    float       cameraFarClip       = 0.0f;
+    float       cameraEv100         = 0.0f;
+    float       cameraExposure      = 0.0f;
+    float       cameraAperture      = 0.0f;
+    float       cameraShutterSpeed  = 0.0f;
+    float       cameraSensitivity   = 0.0f;
+    float       iblLuminance        = 0.0f;
+    int         play                = 0;
+
+    glm::vec3   light               = glm::vec3(0.0f);
+    float       lightIntensity      = 0.0f;
+    glm::vec3   lightColor          = glm::vec3(0.0f);
+    float       lightFalloff        = 0.0f;
+    glm::vec3   lightDirection      = glm::vec3(0.0f);
+    float       padding             = 0.0f;
+    glm::mat4   lightMatrix         = glm::mat4(1.0f);
+
+    glm::vec4   SH[9];
+};
+
+/** Per frame uniforms shared by all passes (time, resolution, camera, the light and the
+ *  spherical harmonics) packed on a single uniform buffer. It's uploaded once per frame and
+ *  programs that declare the block read it from there, while the rest keep getting them as
+ *  plain uniforms. Camera matrices are left out because passes override them. **/
+class GlobalsBlock {
+public:
+    GlobalsBlock();
+    virtual ~GlobalsBlock();
+
+    /** Declaration of the block on GLSL, in one line so it fits on a define **/
+    static const std::string& getSource();
+
+    /** true for the uniforms that are members of the block **/
+    static bool     has(const std::string& _uniform);
+
+    /** Can be called from any thread, the buffer is created on the next upload() **/
+    void            setEnabled(bool _enabled) { m_enabled = _enabled; }
+    bool            isEnabled() const { return m_enabled; }
+
+    /** Sends data to the GPU if it changed since the last time. Once per frame from the GL thread.
+     *  false if the context doesn't support uniform buffers **/
+    bool            upload();
+
+    /** Binds the block of the shader's program, if it has one, to the buffer **/
+    bool            bind(vera::Shader* _shader);
+
+    /** Forgets which programs have the block, after they are recompiled **/
+    void            invalidate() { m_programs.clear(); }
+
+    GlobalsData     data;
+
+protected:
+    void            _clear();
+
+    std::map<unsigned int, bool>    m_programs;
+    GlobalsData     m_uploaded;
+    unsigned int    m_buffer;
+    bool            m_enabled;
+    bool            m_dirty;
+};
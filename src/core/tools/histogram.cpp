@@ -0,0 +1,308 @@
+#include "histogram.h"
+
+#include <chrono>
+#include <vector>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <algorithm>
+
+#if !defined(__EMSCRIPTEN__)
+#include <thread>
+#include <future>
+#include "thread_pool/thread_pool.hpp"
+#endif
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define HISTOGRAM_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+#define HISTOGRAM_LANES 4
+#define HISTOGRAM_BINS  (HISTOGRAM_LANES * 4 * 256)
+
+inline int histogramLuma(int _r, int _g, int _b) { return (77 * _r + 150 * _g + 29 * _b) >> 8; }
+
+// Bins of a lane: [channel * 256 + value]
+inline void histogramAdd(uint32_t* _lane, const unsigned char* _pixel, int _luma) {
+    _lane[         _pixel[0]]++;
+    _lane[256 +    _pixel[1]]++;
+    _lane[512 +    _pixel[2]]++;
+    _lane[768 +    _luma]++;
+}
+
+// Counts the rows [_from, _to) on HISTOGRAM_LANES sub-histograms, pixel x goes to lane x % HISTOGRAM_LANES
+void histogramRows( const unsigned char* _pixels, size_t _stride, int _width, int _from, int _to, int _channels, int _step,
+                    uint32_t* _bins ) {
+    uint32_t* lanes[HISTOGRAM_LANES];
+    for (int i = 0; i < HISTOGRAM_LANES; i++)
+        lanes[i] = _bins + i * 4 * 256;
+
+    #if defined(HISTOGRAM_USE_SSE2)
+    const __m128i weights = _mm_setr_epi16(77, 150, 29, 0, 77, 150, 29, 0);
+    const __m128i zero = _mm_setzero_si128();
+    alignas(16) int32_t luma[4];
+    #endif
+
+    for (int y = _from; y < _to; y++) {
+        const unsigned char* row = _pixels + (size_t)y * _step * _stride;
+        int x = 0;
+
+        #if defined(HISTOGRAM_USE_SSE2)
+        // Luma of 4 RGBA pixels at once: each madd gives (77 R + 150 G, 29 B) of two pixels
+        if (_channels == 4 && _step == 1) {
+            for (; x + 4 <= _width; x += 4) {
+                const unsigned char* p = row + x * 4;
+                __m128i px = _mm_loadu_si128((const __m128i*)p);
+                __m128 lo = _mm_castsi128_ps( _mm_madd_epi16(_mm_unpacklo_epi8(px, zero), weights) );
+                __m128 hi = _mm_castsi128_ps( _mm_madd_epi16(_mm_unpackhi_epi8(px, zero), weights) );
+                __m128i sum = _mm_add_epi32(_mm_castps_si128( _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(2, 0, 2, 0)) ),
+                                            _mm_castps_si128( _mm_shuffle_ps(lo, hi, _MM_SHUFFLE(3, 1, 3, 1)) ));
+                _mm_store_si128((__m128i*)luma, _mm_srli_epi32(sum, 8));
+
+                histogramAdd(lanes[0], p,      luma[0]);
+                histogramAdd(lanes[1], p + 4,  luma[1]);
+                histogramAdd(lanes[2], p + 8,  luma[2]);
+                histogramAdd(lanes[3], p + 12, luma[3]);
+            }
+        }
+        #endif
+
+        for (int i = x; x < _width; x += _step, i++) {
+            const unsigned char* p = row + x * _channels;
+            histogramAdd(lanes[i % HISTOGRAM_LANES], p, histogramLuma(p[0], p[1], p[2]));
+        }
+    }
+}
+
+#if !defined(__EMSCRIPTEN__)
+// Started on the first count and kept, plots count every frame. The calling thread does a share too
+static thread_pool::ThreadPool& histogramPool() {
+    static thread_pool::ThreadPool pool( std::max(2u, std::thread::hardware_concurrency()) - 1 );
+    return pool;
+}
+#endif
+
+void histogramCount(const unsigned char* _pixels, size_t _stride, int _width, int _height, int _channels,
+                    glm::vec4* _counts, int _threads, int _step) {
+    #if defined(__EMSCRIPTEN__)
+    _threads = 1;
+    #else
+    if (_threads <= 0)
+        _threads = std::max(1, (int)std::thread::hardware_concurrency());
+    _threads = std::min(_threads, (int)histogramPool().num_threads() + 1);
+    #endif
+
+    // Each thread needs enough pixels to pay for waking it up
+    _step = std::max(1, _step);
+    int rows = (_height + _step - 1) / _step;
+    int cols = (_width + _step - 1) / _step;
+    _threads = std::max(1, std::min(_threads, (int)(((long long)rows * cols) / 65536)));
+
+    std::vector<uint32_t> bins((size_t)_threads * HISTOGRAM_BINS, 0);
+
+    #if defined(__EMSCRIPTEN__)
+    histogramRows(_pixels, _stride, _width, 0, rows, _channels, _step, &bins[0]);
+    #else
+    std::vector< std::future<void> > workers;
+    for (int i = 1; i < _threads; i++) {
+        int from = (int)(((long long)rows * i) / _threads);
+        int to = (int)(((long long)rows * (i + 1)) / _threads);
+        workers.push_back( histogramPool().Submit(histogramRows, _pixels, _stride, _width, from, to, _channels, _step, &bins[(size_t)i * HISTOGRAM_BINS]) );
+    }
+    histogramRows(_pixels, _stride, _width, 0, rows / _threads, _channels, _step, &bins[0]);
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].wait();
+    #endif
+
+    // Merge the lanes of every thread
+    for (int i = 0; i < 256; i++) {
+        uint32_t r = 0, g = 0, b = 0, l = 0;
+        for (int j = 0; j < _threads * HISTOGRAM_LANES; j++) {
+            const uint32_t* lane = &bins[(size_t)j * 4 * 256];
+            r += lane[i];
+            g += lane[256 + i];
+            b += lane[512 + i];
+            l += lane[768 + i];
+        }
+        _counts[i] = glm::vec4((float)r, (float)g, (float)b, (float)l);
+    }
+}
+
+void histogramCountScalar(  const unsigned char* _pixels, size_t _stride, int _width, int _height, int _channels,
+                            glm::vec4* _counts ) {
+    for (int i = 0; i < 256; i++)
+        _counts[i] = glm::vec4(0.0f);
+
+    for (int y = 0; y < _height; y++) {
+        const unsigned char* row = _pixels + (size_t)y * _stride;
+        for (int x = 0; x < _width; x++) {
+            const unsigned char* p = row + x * _channels;
+            _counts[p[0]].r++;
+            _counts[p[1]].g++;
+            _counts[p[2]].b++;
+            _counts[histogramLuma(p[0], p[1], p[2])].a++;
+        }
+    }
+}
+
+void histogramNormalize(glm::vec4* _counts) {
+    float max_rgb_freq = 1.0f;
+    float max_luma_freq = 1.0f;
+    for (int i = 0; i < 256; i++) {
+        max_rgb_freq = std::max(max_rgb_freq, std::max(_counts[i].r, std::max(_counts[i].g, _counts[i].b)));
+        max_luma_freq = std::max(max_luma_freq, _counts[i].a);
+    }
+
+    for (int i = 0; i < 256; i++)
+        _counts[i] = _counts[i] / glm::vec4(max_rgb_freq, max_rgb_freq, max_rgb_freq, max_luma_freq);
+}
+
+void histogramBenchmark(int _width, int _height, int _iterations) {
+    if (_width <= 0 || _height <= 0 || _iterations <= 0)
+        return;
+
+    // Smooth gradients with noise on top, so some bins are crowded like on a real frame
+    std::vector<unsigned char> frame((size_t)_width * _height * 4);
+    uint32_t seed = 2463534242u;
+    for (int y = 0; y < _height; y++) {
+        for (int x = 0; x < _width; x++) {
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            unsigned char* p = &frame[((size_t)y * _width + x) * 4];
+            p[0] = (unsigned char)((x * 255) / _width);
+            p[1] = (unsigned char)((y * 255) / _height);
+            p[2] = (unsigned char)(seed & 0xff);
+            p[3] = 255;
+        }
+    }
+
+    glm::vec4 reference[256];
+    glm::vec4 lanes[256];
+    glm::vec4 threads[256];
+    const size_t stride = (size_t)_width * 4;
+    const double mpixels = (double)_width * _height * _iterations / 1000000.0;
+
+    auto start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < _iterations; i++)
+        histogramCountScalar(&frame[0], stride, _width, _height, 4, reference);
+    double scalarSecs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < _iterations; i++)
+        histogramCount(&frame[0], stride, _width, _height, 4, lanes, 1);
+    double laneSecs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    start = std::chrono::high_resolution_clock::now();
+    for (int i = 0; i < _iterations; i++)
+        histogramCount(&frame[0], stride, _width, _height, 4, threads);
+    double threadSecs = std::chrono::duration<double>(std::chrono::high_resolution_clock::now() - start).count();
+
+    bool lanesMatch = true;
+    bool threadsMatch = true;
+    for (int i = 0; i < 256; i++) {
+        lanesMatch &= reference[i] == lanes[i];
+        threadsMatch &= reference[i] == threads[i];
+    }
+
+    std::cout << _width << "x" << _height << " x" << _iterations << std::endl;
+    std::cout << "  scalar      " << mpixels / scalarSecs << " Mpx/s" << std::endl;
+    std::cout << "  lanes       " << mpixels / laneSecs << " Mpx/s" << std::endl;
+    std::cout << "  threads     " << mpixels / threadSecs << " Mpx/s" << std::endl;
+    if (!lanesMatch)
+        std::cerr << "  lanes histogram doesn't match the scalar reference" << std::endl;
+    if (!threadsMatch)
+        std::cerr << "  threads histogram doesn't match the scalar reference" << std::endl;
+}
+
+HistogramSampler::HistogramSampler() :
+    m_mode(HISTOGRAM_FULL), m_budget(512 * 512),
+    m_total_partitions(0), m_current(0), m_pending(0),
+    m_width(0), m_height(0), m_step(1), m_tile_width(0), m_tile_height(0), m_cols(1) {
+}
+
+void HistogramSampler::setMode(HistogramSampling _mode) {
+    m_mode = _mode;
+    m_width = m_height = 0;
+}
+
+std::string HistogramSampler::getModeName() const {
+    if (m_mode == HISTOGRAM_STRIDE)
+        return "stride";
+    else if (m_mode == HISTOGRAM_TILES)
+        return "tiles";
+    return "full";
+}
+
+void HistogramSampler::setBudget(size_t _pixels) {
+    m_budget = std::max((size_t)1024, _pixels);
+    m_width = m_height = 0;
+}
+
+void HistogramSampler::_layout(int _width, int _height) {
+    m_width = _width;
+    m_height = _height;
+    m_step = 1;
+    m_tile_width = _width;
+    m_tile_height = _height;
+    m_cols = 1;
+    m_total_partitions = 1;
+
+    size_t pixels = (size_t)_width * _height;
+    if (m_mode == HISTOGRAM_STRIDE && pixels > m_budget) {
+        while ((size_t)m_step * m_step * m_budget < pixels)
+            m_step++;
+        m_cols = m_step;
+        m_total_partitions = (size_t)m_step * m_step;
+    }
+    else if (m_mode == HISTOGRAM_TILES && pixels > m_budget) {
+        m_tile_width = std::min(_width, std::max(1, (int)std::sqrt((double)m_budget)));
+        m_tile_height = std::min(_height, std::max(1, (int)(m_budget / m_tile_width)));
+        m_cols = (_width + m_tile_width - 1) / m_tile_width;
+        m_total_partitions = (size_t)m_cols * ((_height + m_tile_height - 1) / m_tile_height);
+    }
+
+    m_partitions.assign(m_total_partitions * 256, glm::vec4(0.0f));
+    for (int i = 0; i < 256; i++)
+        m_total[i] = glm::vec4(0.0f);
+    m_current = 0;
+    m_pending = m_total_partitions;
+}
+
+HistogramRegion HistogramSampler::next(int _width, int _height) {
+    if (_width != m_width || _height != m_height)
+        _layout(_width, _height);
+
+    int col = (int)(m_current % m_cols);
+    int row = (int)(m_current / m_cols);
+
+    HistogramRegion region;
+    if (m_step > 1) {
+        // every grid starts one pixel away from the previous one, all of them cover the frame
+        region.x = col;
+        region.y = row;
+        region.width = m_width - col;
+        region.height = m_height - row;
+    }
+    else {
+        region.x = col * m_tile_width;
+        region.y = row * m_tile_height;
+        region.width = std::min(m_tile_width, m_width - region.x);
+        region.height = std::min(m_tile_height, m_height - region.y);
+    }
+    region.step = m_step;
+    return region;
+}
+
+void HistogramSampler::add(const glm::vec4* _counts, glm::vec4* _histogram) {
+    // counts are whole numbers far from the float precision limit, so the running sum stays exact
+    glm::vec4* partition = &m_partitions[m_current * 256];
+    for (int i = 0; i < 256; i++) {
+        m_total[i] += _counts[i] - partition[i];
+        partition[i] = _counts[i];
+        _histogram[i] = m_total[i];
+    }
+
+    m_current = (m_current + 1) % m_total_partitions;
+    if (m_pending > 0)
+        m_pending--;
+}
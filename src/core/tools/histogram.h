@@ -0,0 +1,82 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <cstddef>
+
+#include "glm/glm.hpp"
+
+/** Histogram of 8 bits RGB(A) frames for the plot command. Each bin of _counts gets the amount of
+ *  pixels with that red, green, blue and luma value, luma being (77 R + 150 G + 29 B) >> 8.
+ *  Rows are split between up to _threads threads (0 picks them from the hardware), and each thread
+ *  counts on four interleaved sub-histograms so consecutive equal pixels don't wait on the same bin.
+ *  _stride is the length in bytes of a row, _channels 3 (RGB) or 4 (RGBA).
+ *  With a _step bigger than 1 only one of every _step pixels of one of every _step rows is counted. **/
+void    histogramCount( const unsigned char* _pixels, size_t _stride, int _width, int _height, int _channels,
+                        glm::vec4* _counts, int _threads = 0, int _step = 1 );
+
+/** Same counts with one thread and a single histogram. Use it as reference **/
+void    histogramCountScalar(   const unsigned char* _pixels, size_t _stride, int _width, int _height, int _channels,
+                                glm::vec4* _counts );
+
+/** Divides r, g and b by their highest count and luma by its own **/
+void    histogramNormalize(glm::vec4* _counts);
+
+/** Prints the Mpixels/s of both kernels on synthetic _width x _height RGBA frames **/
+void    histogramBenchmark(int _width, int _height, int _iterations = 20);
+
+enum HistogramSampling {
+    HISTOGRAM_FULL = 0,     // every pixel of every frame
+    HISTOGRAM_STRIDE,       // one of every n x n pixels, shifting the grid each frame
+    HISTOGRAM_TILES         // one tile per frame
+};
+
+/** Area of the frame to count: every _step pixels from x, y to x + width, y + height **/
+struct HistogramRegion {
+    int x, y, width, height, step;
+};
+
+/** Bounds the pixels counted per frame to a budget by splitting the frame in partitions that are
+ *  counted one per frame, either strided grids shifted by one pixel or tiles. The histogram is the
+ *  sum of the last counts of every partition, so it updates smoothly and becomes exact once all of
+ *  them were counted on the same frame. **/
+class HistogramSampler {
+public:
+    HistogramSampler();
+
+    void                setMode(HistogramSampling _mode);
+    HistogramSampling   getMode() const { return m_mode; }
+    std::string         getModeName() const;
+
+    void                setBudget(size_t _pixels);
+    size_t              getBudget() const { return m_budget; }
+
+    /** Region of a _width x _height frame to count next **/
+    HistogramRegion     next(int _width, int _height);
+
+    /** Keeps the counts of the region given by next() and writes the integrated histogram on _histogram **/
+    void                add(const glm::vec4* _counts, glm::vec4* _histogram);
+
+    /** Marks every partition as outdated, after the frame changes **/
+    void                invalidate() { m_pending = m_total_partitions; }
+
+    /** true while some partition wasn't counted since the last invalidate() **/
+    bool                isPending() const { return m_pending > 0; }
+
+protected:
+    void                _layout(int _width, int _height);
+
+    std::vector<glm::vec4>  m_partitions;   // 256 bins per partition
+    glm::vec4           m_total[256];
+    HistogramSampling   m_mode;
+    size_t              m_budget;
+    size_t              m_total_partitions;
+    size_t              m_current;
+    size_t              m_pending;
+    int                 m_width;
+    int                 m_height;
+    int                 m_step;
+    int                 m_tile_width;
+    int                 m_tile_height;
+    int                 m_cols;
+};
@@ -0,0 +1,136 @@
+#include "histogramPass.h"
+
+#include <iostream>
+
+#include "vera/gl/gl.h"
+#include "vera/ops/draw.h"
+#include "vera/types/mesh.h"
+
+const std::string histogram_vert = R"(
+#ifdef GL_ES
+precision highp float;
+#endif
+
+uniform sampler2D   u_tex0;
+uniform vec2        u_tex0Resolution;
+uniform vec2        u_offset;   // first pixel of the counted region
+uniform vec2        u_size;     // and its size
+uniform vec4        u_channel;  // which of r, g, b or luma to count
+
+attribute vec4      a_position; // center of the pixel to count, relative to u_offset
+
+void main() {
+    vec2 uv = (a_position.xy + u_offset) / u_tex0Resolution;
+    vec3 color = floor(texture2DLod(u_tex0, uv, 0.0).rgb * 255.0 + 0.5);
+    float luma = floor(dot(color, vec3(77.0, 150.0, 29.0)) / 256.0);
+    float value = dot(vec4(color, luma), u_channel);
+
+    gl_PointSize = 1.0;
+    gl_Position = vec4((value + 0.5) / 128.0 - 1.0, 0.0, 0.0, 1.0);
+
+    // the points are shared by regions of different sizes, the ones outside are clipped away
+    if (any(greaterThanEqual(a_position.xy, u_size)))
+        gl_Position = vec4(2.0, 2.0, 0.0, 1.0);
+}
+)";
+
+const std::string histogram_frag = R"(
+#ifdef GL_ES
+precision highp float;
+#endif
+
+void main() {
+    gl_FragColor = vec4(1.0);
+}
+)";
+
+HistogramPass::HistogramPass() : m_cols(0), m_rows(0), m_step(0), m_supported(-1) {
+}
+
+HistogramPass::~HistogramPass() {
+}
+
+bool HistogramPass::_allocate() {
+    if (m_supported >= 0)
+        return m_supported > 0;
+
+    // the points look up their color on the vertex shader
+    GLint units = 0;
+    glGetIntegerv(GL_MAX_VERTEX_TEXTURE_IMAGE_UNITS, &units);
+    if (units <= 0) {
+        std::cout << "GPU histogram needs vertex texture fetch, counting on CPU" << std::endl;
+        m_supported = 0;
+        return false;
+    }
+
+    m_shader.setSource(histogram_frag, histogram_vert);
+    m_fbo.allocate(256, 1, vera::COLOR_FLOAT_TEXTURE);
+
+    // not every context can render (and blend) on float textures
+    m_fbo.bind();
+    m_supported = glCheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE;
+    m_fbo.unbind();
+
+    if (!m_supported)
+        std::cout << "GPU histogram is not supported by this context, counting on CPU" << std::endl;
+
+    return m_supported > 0;
+}
+
+// One point per counted pixel, at the center of its texel
+void HistogramPass::_points(int _cols, int _rows, int _step) {
+    vera::Mesh mesh;
+    mesh.setDrawMode(vera::POINTS);
+    for (int y = 0; y < _rows; y++)
+        for (int x = 0; x < _cols; x++)
+            mesh.addVertex( glm::vec3(x * _step + 0.5f, y * _step + 0.5f, 0.0f) );
+
+    m_points = std::unique_ptr<vera::Vbo>(new vera::Vbo(mesh));
+    m_cols = _cols;
+    m_rows = _rows;
+    m_step = _step;
+}
+
+bool HistogramPass::process(const vera::Fbo* _src, int _width, int _height, const HistogramRegion& _region, glm::vec4* _counts) {
+    if (!_allocate())
+        return false;
+
+    int cols = (_region.width + _region.step - 1) / _region.step;
+    int rows = (_region.height + _region.step - 1) / _region.step;
+    // Strided grids and border tiles are a bit smaller, they reuse the points as long as they don't waste half of them
+    if (!m_points || m_step != _region.step || cols > m_cols || rows > m_rows || (size_t)m_cols * m_rows > (size_t)cols * rows * 2)
+        _points(cols, rows, _region.step);
+
+    GLfloat clearColor[4];
+    glGetFloatv(GL_COLOR_CLEAR_VALUE, clearColor);
+
+    m_fbo.bind();
+    glClearColor(0.0f, 0.0f, 0.0f, 0.0f);
+    glClear(GL_COLOR_BUFFER_BIT);
+
+    vera::setDepthTest(false);
+    glEnable(GL_BLEND);
+    glBlendFunc(GL_ONE, GL_ONE);
+
+    m_shader.use();
+    m_shader.setUniformTexture("u_tex0", _src, 0);
+    m_shader.setUniform("u_tex0Resolution", (float)_width, (float)_height);
+    m_shader.setUniform("u_offset", (float)_region.x, (float)_region.y);
+    m_shader.setUniform("u_size", (float)_region.width, (float)_region.height);
+
+    const glm::vec4 channels[4] = { glm::vec4(1.0, 0.0, 0.0, 0.0), glm::vec4(0.0, 1.0, 0.0, 0.0),
+                                    glm::vec4(0.0, 0.0, 1.0, 0.0), glm::vec4(0.0, 0.0, 0.0, 1.0) };
+    for (int i = 0; i < 4; i++) {
+        glColorMask(i == 0, i == 1, i == 2, i == 3);
+        m_shader.setUniform("u_channel", channels[i]);
+        m_points->render(&m_shader);
+    }
+    glColorMask(GL_TRUE, GL_TRUE, GL_TRUE, GL_TRUE);
+
+    glReadPixels(0, 0, 256, 1, GL_RGBA, GL_FLOAT, &_counts[0]);
+    m_fbo.unbind();
+
+    glClearColor(clearColor[0], clearColor[1], clearColor[2], clearColor[3]);
+    vera::blendMode(vera::BLEND_ALPHA);
+    return true;
+}
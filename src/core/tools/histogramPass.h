@@ -0,0 +1,37 @@
+#pragma once
+
+#include <memory>
+
+#include "vera/gl/fbo.h"
+#include "vera/gl/vbo.h"
+#include "vera/gl/shader.h"
+#include "glm/glm.hpp"
+
+#include "histogram.h"
+
+/** Counts the histogram of a frame on the GPU. Every pixel is a point whose vertex shader reads its
+ *  color and moves it to the bin of its value on a 256x1 float FBO, where additive blending adds them.
+ *  Red, green, blue and luma go on one pass each, masked to their own channel, so only 256 texels
+ *  need to be read back. Needs vertex texture fetch and blending on float render targets. **/
+class HistogramPass {
+public:
+    HistogramPass();
+    virtual ~HistogramPass();
+
+    /** Writes on _counts the amount of pixels of _src (of _width x _height) on each bin (r, g, b and luma),
+     *  counting only the pixels of _region. Returns false if it couldn't, so the caller can count them on CPU.
+     *  Whether the context supports it is checked on the first call, so it has to come from the GL thread **/
+    bool    process(const vera::Fbo* _src, int _width, int _height, const HistogramRegion& _region, glm::vec4* _counts);
+
+protected:
+    bool    _allocate();
+    void    _points(int _cols, int _rows, int _step);
+
+    vera::Shader                m_shader;
+    vera::Fbo                   m_fbo;
+    std::unique_ptr<vera::Vbo>  m_points;
+    int                         m_cols;
+    int                         m_rows;
+    int                         m_step;
+    int                         m_supported;    // -1 until the first call checks the context
+};
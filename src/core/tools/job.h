@@ -5,14 +5,15 @@
 #include <string>
 #include <utility>
 
-#include "vera/ops/pixel.h"
+#include "pixelPool.h"
+#include "rawSequence.h"
 
 /** Just a small helper that captures all the relevant data to save an image **/
 class Job {
 public:
     Job (const Job& ) = delete;
     Job (Job && ) = default;
-    Job (std::string _filename, int _width, int _height, std::unique_ptr<unsigned char[]>&& _pixels,
+    Job (std::string _filename, int _width, int _height, Pixels&& _pixels,
          std::atomic<int>& _task_count, std::atomic<long long>& _max_mem_in_queue):
 
         m_filename(std::move(_filename)),
@@ -30,7 +31,7 @@ public:
     /** the function that is being invoked when the task is done **/
     void operator()() {
         if (m_pixels) {
-            vera::savePixels(m_filename, m_pixels.get(), m_width, m_height);
+            rawSavePixels(m_filename, m_pixels.get(), m_width, m_height);
             m_pixels = nullptr;
             (*m_task_count)--;
             (*m_max_mem_in_queue) += mem_consumed_by_pixels();
@@ -42,7 +43,7 @@ protected:
     std::string                         m_filename;
     int                                 m_width;
     int                                 m_height;
-    std::unique_ptr<unsigned char[]>    m_pixels;
+    Pixels                              m_pixels;
     std::atomic<int> *                  m_task_count;
     std::atomic<long long> *            m_max_mem_in_queue;
 
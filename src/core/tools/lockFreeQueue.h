@@ -1,44 +1,116 @@
 #pragma once
 
-#include <list>
-#include <iterator>
+#include <mutex>
+#include <atomic>
+#include <chrono>
+#include <vector>
+#include <condition_variable>
 
-using Pixels        = std::unique_ptr<unsigned char[]>;
+#include "pixelPool.h"
 
+#define LOCKFREEQUEUE_CACHE_LINE 64
+
+/** Bounded single producer / single consumer ring buffer.
+ *  The producer publishes a slot with a release store on the tail that the consumer
+ *  acquires, and the other way around for the head. Each index sits on its own cache
+ *  line so both threads don't fight over it. When the ring is full produce() blocks,
+ *  which is the backpressure that keeps memory bounded if the consumer falls behind.
+ *  On the other side consumeWait() lets the consumer sleep until a new element arrives.
+ *  A thread that goes to sleep raises its waiting flag and then checks the indices, while the other
+ *  one moves an index and then checks the flag. Those stores and loads are seq_cst on both sides
+ *  (rather than fences, which ThreadSanitizer can't follow) so at least one of them sees the other
+ *  and no wakeup is missed. **/
+template<typename T>
 class LockFreeQueue {
 public:
 
-    LockFreeQueue() {
-        // Add one to validate the iterators
-        m_list.push_back( Pixels() );
-        m_headIt = m_list.begin();
-        m_tailIt = m_list.end();
+    LockFreeQueue(size_t _capacity = 16) :
+        m_buffer(_capacity + 1),    // one slot is always kept empty to tell full from empty
+        m_head(0), m_tail(0), m_producerWaiting(false), m_consumerWaiting(false) {
     }
 
-    void produce( std::unique_ptr<unsigned char[]>&& t ) {
-        m_list.push_back( std::move(t) );
-        m_tailIt = m_list.end();
-        m_list.erase( m_list.begin(), m_headIt );
+    /** called only from the producer thread. Returns false if the ring is full **/
+    bool tryProduce( T&& _t ) {
+        const size_t tail = m_tail.load(std::memory_order_relaxed);
+        const size_t next = increment(tail);
+        if ( next == m_head.load(std::memory_order_acquire) )
+            return false;
+
+        m_buffer[tail] = std::move(_t);
+        m_tail.store(next, std::memory_order_seq_cst);
+
+        if ( m_consumerWaiting.load(std::memory_order_seq_cst) ) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_data.notify_one();
+        }
+        return true;
     }
 
-    bool consume( std::unique_ptr<unsigned char[]>&& t ) {
-        typename PixelList::iterator nextIt = m_headIt;
-        ++nextIt;
-        if ( nextIt != m_tailIt ) {
-            m_headIt = nextIt;
-            t        = std::move( *m_headIt );
-            return true;
+    /** called only from the producer thread. Blocks while the ring is full **/
+    void produce( T&& _t ) {
+        while ( !tryProduce( std::move(_t) ) ) {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_producerWaiting.store(true, std::memory_order_seq_cst);
+            m_space.wait(lock, [this]{ return !full(); });
+            m_producerWaiting.store(false, std::memory_order_relaxed);
+        }
+    }
+
+    /** called only from the consumer thread. Returns false if there is nothing to consume **/
+    bool consume( T& _t ) {
+        const size_t head = m_head.load(std::memory_order_relaxed);
+        if ( head == m_tail.load(std::memory_order_acquire) )
+            return false;
+
+        _t = std::move(m_buffer[head]);
+        m_head.store(increment(head), std::memory_order_seq_cst);
+
+        if ( m_producerWaiting.load(std::memory_order_seq_cst) ) {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_space.notify_one();
         }
+        return true;
+    }
 
-        return false;
+    /** called only from the consumer thread. Sleeps until there is something to consume or the timeout expires **/
+    template<class Rep, class Period>
+    bool consumeWait( T& _t, const std::chrono::duration<Rep, Period>& _timeout ) {
+        if ( consume(_t) )
+            return true;
+
+        {
+            std::unique_lock<std::mutex> lock(m_mutex);
+            m_consumerWaiting.store(true, std::memory_order_seq_cst);
+            m_data.wait_for(lock, _timeout, [this]{ return !empty(); });
+            m_consumerWaiting.store(false, std::memory_order_relaxed);
+        }
+        return consume(_t);
     }
 
-    int size() const { return std::distance( m_headIt, m_tailIt ) - 1; }
-    typename std::list<Pixels>::iterator getHead() const { return m_headIt; }
-    typename std::list<Pixels>::iterator getTail() const { return m_tailIt; }
+    // seq_cst so the checks made after raising a waiting flag pair with the other side's index store
+    size_t  size() const {
+        const size_t head = m_head.load(std::memory_order_seq_cst);
+        const size_t tail = m_tail.load(std::memory_order_seq_cst);
+        return (tail + m_buffer.size() - head) % m_buffer.size();
+    }
+    size_t  capacity() const { return m_buffer.size() - 1; }
+    bool    empty() const { return size() == 0; }
+    bool    full() const { return size() == capacity(); }
 
 private:
-    using PixelList = std::list<Pixels>;
-    PixelList                       m_list;
-    typename PixelList::iterator    m_headIt, m_tailIt;
+    size_t  increment(size_t _index) const { return (_index + 1) % m_buffer.size(); }
+
+    std::vector<T>          m_buffer;
+
+    char                    m_pad0[LOCKFREEQUEUE_CACHE_LINE];
+    std::atomic<size_t>     m_head;     // written only by the consumer
+    char                    m_pad1[LOCKFREEQUEUE_CACHE_LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t>     m_tail;     // written only by the producer
+    char                    m_pad2[LOCKFREEQUEUE_CACHE_LINE - sizeof(std::atomic<size_t>)];
+
+    std::atomic<bool>       m_producerWaiting;
+    std::atomic<bool>       m_consumerWaiting;
+    std::mutex              m_mutex;
+    std::condition_variable m_space;
+    std::condition_variable m_data;
 };
@@ -0,0 +1,89 @@
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <cstdint>
+
+#define MPSCQUEUE_CACHE_LINE 64
+
+/** Bounded multiple producers / single consumer queue (Dmitry Vyukov's algorithm).
+ *  Every cell carries a sequence number that tells whose turn it is: producers claim a
+ *  position with a CAS on the tail and publish the cell bumping its sequence, the consumer
+ *  takes it and bumps it again one lap ahead so it can be reused. No producer ever waits on
+ *  another one holding a lock, and the consumer never blocks. **/
+template<typename T>
+class MpscQueue {
+public:
+
+    /** _capacity is rounded up to a power of two **/
+    MpscQueue(size_t _capacity = 1024) : m_enqueue(0), m_dequeue(0) {
+        size_t capacity = 2;
+        while (capacity < _capacity)
+            capacity *= 2;
+
+        m_mask = capacity - 1;
+        m_cells.reset(new Cell[capacity]);
+        for (size_t i = 0; i < capacity; i++)
+            m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    /** called from any thread. Returns false if the queue is full **/
+    bool tryProduce( T&& _t ) {
+        size_t pos = m_enqueue.load(std::memory_order_relaxed);
+        Cell* cell;
+        while (true) {
+            cell = &m_cells[pos & m_mask];
+            const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            const intptr_t diff = (intptr_t)sequence - (intptr_t)pos;
+            if (diff == 0) {
+                if (m_enqueue.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+                return false;
+            else
+                pos = m_enqueue.load(std::memory_order_relaxed);
+        }
+
+        cell->data = std::move(_t);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /** called from any thread. Yields while the queue is full, so a slow consumer slows producers down instead of growing memory **/
+    void produce( T&& _t ) {
+        while ( !tryProduce( std::move(_t) ) )
+            std::this_thread::yield();
+    }
+
+    /** called only from the consumer thread. Returns false if there is nothing to consume **/
+    bool consume( T& _t ) {
+        Cell* cell = &m_cells[m_dequeue & m_mask];
+        const size_t sequence = cell->sequence.load(std::memory_order_acquire);
+        if ((intptr_t)sequence - (intptr_t)(m_dequeue + 1) < 0)
+            return false;
+
+        _t = std::move(cell->data);
+        cell->sequence.store(m_dequeue + m_mask + 1, std::memory_order_release);
+        m_dequeue++;
+        return true;
+    }
+
+    size_t  capacity() const { return m_mask + 1; }
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T                   data;
+    };
+
+    std::unique_ptr<Cell[]> m_cells;
+    size_t                  m_mask;
+
+    char                    m_pad0[MPSCQUEUE_CACHE_LINE];
+    std::atomic<size_t>     m_enqueue;  // shared by the producers
+    char                    m_pad1[MPSCQUEUE_CACHE_LINE - sizeof(std::atomic<size_t>)];
+    size_t                  m_dequeue;  // only touched by the consumer
+    char                    m_pad2[MPSCQUEUE_CACHE_LINE - sizeof(size_t)];
+};
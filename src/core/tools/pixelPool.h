@@ -0,0 +1,84 @@
+#pragma once
+
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <condition_variable>
+
+class PixelPool;
+
+/** Deleter that gives the buffer back to the pool it came from (or frees it if it has none) **/
+struct PixelRecycler {
+    std::shared_ptr<PixelPool> pool;
+    void operator()(unsigned char* _pixels) const;
+};
+
+using Pixels        = std::unique_ptr<unsigned char[], PixelRecycler>;
+
+/** Fixed amount of frame buffers of the same size, recycled between the GL thread
+ *  and the saver/encoder threads instead of going through malloc every frame.
+ *  Buffers are allocated the first time they are needed and kept until the pool dies.
+ *  Each buffer holds a reference to the pool, so it can be replaced (ex. on resize)
+ *  while old frames are still being saved. **/
+class PixelPool : public std::enable_shared_from_this<PixelPool> {
+public:
+    static std::shared_ptr<PixelPool> create(size_t _bufferSize, size_t _capacity) {
+        return std::shared_ptr<PixelPool>( new PixelPool(_bufferSize, _capacity) );
+    }
+
+    /** returns a free buffer, blocking until one is released if all of them are in use **/
+    Pixels acquire() {
+        std::unique_lock<std::mutex> lock(m_mutex);
+
+        if (m_free.empty() && m_storage.size() < m_capacity) {
+            m_storage.emplace_back( new unsigned char[m_bufferSize] );
+            m_free.push_back( m_storage.back().get() );
+        }
+
+        m_available.wait(lock, [this]{ return !m_free.empty(); });
+        unsigned char* pixels = m_free.back();
+        m_free.pop_back();
+
+        return Pixels(pixels, PixelRecycler{ shared_from_this() });
+    }
+
+    size_t  getBufferSize() const { return m_bufferSize; }
+    size_t  getCapacity() const { return m_capacity; }
+
+private:
+    friend struct PixelRecycler;
+
+    PixelPool(size_t _bufferSize, size_t _capacity) :
+        m_bufferSize(_bufferSize),
+        m_capacity(_capacity > 0 ? _capacity : 1) {
+        m_storage.reserve(m_capacity);
+        m_free.reserve(m_capacity);
+    }
+
+    void release(unsigned char* _pixels) {
+        {
+            std::lock_guard<std::mutex> lock(m_mutex);
+            m_free.push_back(_pixels);
+        }
+        m_available.notify_one();
+    }
+
+    std::vector< std::unique_ptr<unsigned char[]> > m_storage;
+    std::vector<unsigned char*>     m_free;
+
+    std::mutex                      m_mutex;
+    std::condition_variable         m_available;
+
+    size_t                          m_bufferSize;
+    size_t                          m_capacity;
+};
+
+inline void PixelRecycler::operator()(unsigned char* _pixels) const {
+    if (_pixels == nullptr)
+        return;
+
+    if (pool)
+        pool->release(_pixels);
+    else
+        delete [] _pixels;
+}
@@ -0,0 +1,343 @@
+#include "rawSequence.h"
+
+#include <cstring>
+#include <vector>
+#include <cstdio>
+#include <iostream>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#define RAW_USE_MMAP
+#define RAW_SEEK( file, offset ) fseeko( file, (off_t)offset, SEEK_SET )
+#else
+#define RAW_SEEK( file, offset ) _fseeki64( file, (__int64)offset, SEEK_SET )
+#endif
+
+#include "vera/ops/fs.h"
+#include "vera/ops/pixel.h"
+#include "vera/ops/string.h"
+
+// 8 bits to half float. Every value of n/255 is a normal half (or zero), so there is no need
+// to handle denormals, infinities or NaNs
+inline uint16_t rawToHalf(unsigned char _value) {
+    if (_value == 0)
+        return 0;
+
+    float f = _value / 255.0f;
+    uint32_t bits;
+    std::memcpy(&bits, &f, sizeof(bits));
+
+    uint32_t exponent = ((bits >> 23) & 0xFF) - 127 + 15;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    // round to nearest
+    mantissa += 0x1000;
+    if (mantissa & 0x800000) {
+        mantissa = 0;
+        exponent++;
+    }
+    return (uint16_t)((exponent << 10) | (mantissa >> 13));
+}
+
+inline float rawFromHalf(uint16_t _value) {
+    uint32_t exponent = (_value >> 10) & 0x1F;
+    uint32_t mantissa = _value & 0x3FF;
+    uint32_t bits = (uint32_t)(_value & 0x8000) << 16;
+
+    if (exponent == 0 && mantissa == 0) {
+        // zero
+    }
+    else if (exponent == 0) {
+        // denormal
+        exponent = 127 - 15 + 1;
+        while ((mantissa & 0x400) == 0) {
+            mantissa <<= 1;
+            exponent--;
+        }
+        bits |= (exponent << 23) | ((mantissa & 0x3FF) << 13);
+    }
+    else if (exponent == 31)
+        bits |= 0x7F800000 | (mantissa << 13);
+    else
+        bits |= ((exponent - 15 + 127) << 23) | (mantissa << 13);
+
+    float f;
+    std::memcpy(&f, &bits, sizeof(f));
+    return f;
+}
+
+inline size_t rawFrameSize(int _width, int _height, bool _half) {
+    return (size_t)_width * _height * 4 * (_half ? 2 : 1);
+}
+
+// Copies a bottom-up RGBA frame into _dst top-down, converting it to half floats if needed
+void rawCopyFrame(unsigned char* _dst, const unsigned char* _rgba, int _width, int _height, bool _half) {
+    const size_t srcStride = (size_t)_width * 4;
+    for (int y = 0; y < _height; y++) {
+        const unsigned char* src = _rgba + (size_t)(_height - 1 - y) * srcStride;
+        if (_half) {
+            uint16_t* dst = (uint16_t*)(_dst + (size_t)y * srcStride * 2);
+            for (size_t i = 0; i < srcStride; i++)
+                dst[i] = rawToHalf(src[i]);
+        }
+        else
+            std::memcpy(_dst + (size_t)y * srcStride, src, srcStride);
+    }
+}
+
+void rawFillHeader(RawHeader& _header, const char* _magic, int _width, int _height, bool _half, size_t _frames) {
+    std::memset(&_header, 0, sizeof(RawHeader));
+    std::memcpy(_header.magic, _magic, 4);
+    _header.version = RAW_VERSION;
+    _header.width = _width;
+    _header.height = _height;
+    _header.channels = 4;
+    _header.half = _half ? 1 : 0;
+    _header.frames = (uint32_t)_frames;
+    _header.count = 0;
+}
+
+// Maps _size bytes of a new file, preallocating them on disk. Returns nullptr on failure
+unsigned char* rawMap(const std::string& _path, size_t _size, int& _fd) {
+    #if defined(RAW_USE_MMAP)
+    _fd = ::open(_path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (_fd < 0)
+        return nullptr;
+
+    #if defined(__linux__)
+    bool allocated = posix_fallocate(_fd, 0, _size) == 0;
+    #else
+    bool allocated = false;
+    #endif
+    if (!allocated && ftruncate(_fd, _size) != 0) {
+        ::close(_fd);
+        _fd = -1;
+        return nullptr;
+    }
+
+    void* data = mmap(NULL, _size, PROT_READ | PROT_WRITE, MAP_SHARED, _fd, 0);
+    if (data == MAP_FAILED) {
+        ::close(_fd);
+        _fd = -1;
+        return nullptr;
+    }
+    return (unsigned char*)data;
+    #else
+    // No mmap: keep the frame in memory and write it on rawUnmap
+    _fd = -1;
+    return new unsigned char[_size];
+    #endif
+}
+
+void rawUnmap(const std::string& _path, unsigned char* _data, size_t _size, int _fd) {
+    #if defined(RAW_USE_MMAP)
+    munmap(_data, _size);
+    ::close(_fd);
+    #else
+    FILE* file = fopen(_path.c_str(), "wb");
+    if (file) {
+        fwrite(_data, 1, _size, file);
+        fclose(file);
+    }
+    delete [] _data;
+    #endif
+}
+
+bool rawSaveFrame(const std::string& _path, const unsigned char* _rgba, int _width, int _height, bool _half) {
+    size_t size = sizeof(RawHeader) + rawFrameSize(_width, _height, _half);
+
+    int fd = -1;
+    unsigned char* data = rawMap(_path, size, fd);
+    if (!data) {
+        std::cerr << "Can't write " << _path << std::endl;
+        return false;
+    }
+
+    RawHeader header;
+    rawFillHeader(header, RAW_MAGIC, _width, _height, _half, 1);
+    header.count = 1;
+    std::memcpy(data, &header, sizeof(RawHeader));
+    rawCopyFrame(data + sizeof(RawHeader), _rgba, _width, _height, _half);
+
+    rawUnmap(_path, data, size, fd);
+    return true;
+}
+
+bool rawSavePixels(const std::string& _path, const unsigned char* _rgba, int _width, int _height) {
+    std::string ext = vera::getExt(_path);
+    if (ext == "raw" || ext == "rawh")
+        return rawSaveFrame(_path, _rgba, _width, _height, ext == "rawh");
+
+    vera::savePixels(_path, (unsigned char*)_rgba, _width, _height);
+    return true;
+}
+
+// ------------------------------------------------------------------------- CONTAINER
+
+RawContainer::RawContainer() :
+    m_data(nullptr), m_size(0), m_capacity(0), m_frameSize(0), m_count(0),
+    m_width(0), m_height(0), m_half(false), m_fd(-1) {
+}
+
+RawContainer::~RawContainer() {
+    close();
+}
+
+bool RawContainer::open(const std::string& _path, int _width, int _height, bool _half, size_t _capacity) {
+    close();
+
+    m_path = _path;
+    m_width = _width;
+    m_height = _height;
+    m_half = _half;
+    m_capacity = _capacity;
+    m_count = 0;
+    m_frameSize = rawFrameSize(_width, _height, _half);
+
+    size_t dataStart = sizeof(RawHeader) + sizeof(RawIndexEntry) * _capacity;
+    m_size = dataStart + m_frameSize * _capacity;
+
+    m_data = rawMap(m_path, m_size, m_fd);
+    if (!m_data) {
+        std::cerr << "Can't allocate " << m_size << " bytes for " << m_path << std::endl;
+        return false;
+    }
+
+    RawHeader header;
+    rawFillHeader(header, RAW_CONTAINER_MAGIC, _width, _height, _half, _capacity);
+    std::memcpy(m_data, &header, sizeof(RawHeader));
+
+    RawIndexEntry* index = (RawIndexEntry*)(m_data + sizeof(RawHeader));
+    for (size_t i = 0; i < _capacity; i++) {
+        index[i].offset = dataStart + m_frameSize * i;
+        index[i].frame = -1;
+        index[i].time = 0.0f;
+    }
+
+    return true;
+}
+
+bool RawContainer::write(size_t _slot, int _frame, float _time, const unsigned char* _rgba) {
+    if (!m_data || _slot >= m_capacity)
+        return false;
+
+    RawIndexEntry* entry = (RawIndexEntry*)(m_data + sizeof(RawHeader)) + _slot;
+    rawCopyFrame(m_data + entry->offset, _rgba, m_width, m_height, m_half);
+    entry->frame = _frame;
+    entry->time = _time;
+    m_count++;
+    return true;
+}
+
+void RawContainer::close() {
+    if (!m_data)
+        return;
+
+    ((RawHeader*)m_data)->count = (uint32_t)m_count.load();
+    rawUnmap(m_path, m_data, m_size, m_fd);
+    m_data = nullptr;
+    m_fd = -1;
+}
+
+// ------------------------------------------------------------------------- CONVERTER
+
+// Saves a top-down frame from a raw file or container as an image
+bool rawConvertFrame(const unsigned char* _data, const RawHeader& _header, const std::string& _file) {
+    const int width = _header.width;
+    const int height = _header.height;
+    const size_t stride = (size_t)width * 4;
+    const std::string ext = vera::getExt(_file);
+
+    // vera saves from bottom-up pixels, as they come from the GPU
+    if (ext == "hdr" || ext == "exr") {
+        std::vector<float> pixels(stride * height);
+        for (int y = 0; y < height; y++) {
+            float* dst = &pixels[(size_t)(height - 1 - y) * stride];
+            if (_header.half) {
+                const uint16_t* src = (const uint16_t*)_data + (size_t)y * stride;
+                for (size_t i = 0; i < stride; i++)
+                    dst[i] = rawFromHalf(src[i]);
+            }
+            else {
+                const unsigned char* src = _data + (size_t)y * stride;
+                for (size_t i = 0; i < stride; i++)
+                    dst[i] = src[i] / 255.0f;
+            }
+        }
+        vera::savePixelsFloat(_file, &pixels[0], width, height);
+        return true;
+    }
+
+    std::vector<unsigned char> pixels(stride * height);
+    for (int y = 0; y < height; y++) {
+        unsigned char* dst = &pixels[(size_t)(height - 1 - y) * stride];
+        if (_header.half) {
+            const uint16_t* src = (const uint16_t*)_data + (size_t)y * stride;
+            for (size_t i = 0; i < stride; i++) {
+                float v = rawFromHalf(src[i]);
+                v = (v < 0.0f)? 0.0f : ((v > 1.0f)? 1.0f : v);
+                dst[i] = (unsigned char)(v * 255.0f + 0.5f);
+            }
+        }
+        else
+            std::memcpy(dst, _data + (size_t)y * stride, stride);
+    }
+    vera::savePixels(_file, &pixels[0], width, height);
+    return true;
+}
+
+bool rawConvert(const std::string& _input, const std::string& _ext) {
+    FILE* file = fopen(_input.c_str(), "rb");
+    if (!file) {
+        std::cerr << "Can't open " << _input << std::endl;
+        return false;
+    }
+
+    RawHeader header;
+    if (fread(&header, sizeof(RawHeader), 1, file) != 1 || header.version != RAW_VERSION || header.channels != 4) {
+        std::cerr << _input << " is not a raw frame or sequence" << std::endl;
+        fclose(file);
+        return false;
+    }
+
+    const size_t frameSize = rawFrameSize(header.width, header.height, header.half != 0);
+    std::vector<unsigned char> data(frameSize);
+    std::string basename = _input.substr(0, _input.size() - vera::getExt(_input).size() - 1);
+    bool rta = true;
+
+    if (std::memcmp(header.magic, RAW_MAGIC, 4) == 0) {
+        rta = fread(&data[0], frameSize, 1, file) == 1 && rawConvertFrame(&data[0], header, basename + "." + _ext);
+        if (rta)
+            std::cout << "Saved " << basename << "." << _ext << std::endl;
+    }
+    else if (std::memcmp(header.magic, RAW_CONTAINER_MAGIC, 4) == 0) {
+        std::vector<RawIndexEntry> index(header.frames);
+        if (header.frames > 0 && fread(&index[0], sizeof(RawIndexEntry), header.frames, file) != header.frames)
+            rta = false;
+
+        size_t converted = 0;
+        for (size_t i = 0; rta && i < index.size(); i++) {
+            if (index[i].frame < 0)
+                continue;
+
+            if (RAW_SEEK(file, index[i].offset) != 0 || fread(&data[0], frameSize, 1, file) != 1) {
+                rta = false;
+                break;
+            }
+
+            rta = rawConvertFrame(&data[0], header, basename + "_" + vera::toString(index[i].frame, 0, 5, '0') + "." + _ext);
+            converted++;
+        }
+
+        if (rta)
+            std::cout << "Saved " << converted << " frames from " << _input << std::endl;
+    }
+    else {
+        std::cerr << _input << " is not a raw frame or sequence" << std::endl;
+        rta = false;
+    }
+
+    fclose(file);
+    return rta;
+}
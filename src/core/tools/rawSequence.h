@@ -0,0 +1,70 @@
+#pragma once
+
+#include <string>
+#include <atomic>
+#include <cstdint>
+
+/** Uncompressed frames for intermediate renders that feed other tools. Saving one is a copy into a
+ *  preallocated memory-mapped file, so an export is bound by bandwidth instead of by the encoder.
+ *  Pixels are stored top-down RGBA, either 8 bits or half floats per channel, after a RawHeader.
+ *  A container (.gvr) holds many frames of the same size after its header and a frame index. **/
+
+#define RAW_MAGIC           "GVRF"
+#define RAW_CONTAINER_MAGIC "GVRC"
+#define RAW_VERSION         1
+
+struct RawHeader {
+    char        magic[4];
+    uint32_t    version;
+    uint32_t    width;
+    uint32_t    height;
+    uint32_t    channels;
+    uint32_t    half;       // 0 for 8 bits per channel, 1 for half floats
+    uint32_t    frames;     // 1 for single frames, capacity for containers
+    uint32_t    count;      // frames written
+};
+
+struct RawIndexEntry {
+    uint64_t    offset;     // from the beginning of the file
+    int32_t     frame;      // -1 when the slot was never written
+    float       time;
+};
+
+/** _rgba is bottom-up, as it comes from glReadPixels **/
+bool    rawSaveFrame(const std::string& _path, const unsigned char* _rgba, int _width, int _height, bool _half);
+
+/** Saves .raw/.rawh files with rawSaveFrame() and any other image through vera::savePixels() **/
+bool    rawSavePixels(const std::string& _path, const unsigned char* _rgba, int _width, int _height);
+
+/** Converts a raw frame (.raw/.rawh) or every frame of a container (.gvr) to images of type _ext.
+ *  Float formats (hdr) keep the half float precision. **/
+bool    rawConvert(const std::string& _input, const std::string& _ext);
+
+class RawContainer {
+public:
+    RawContainer();
+    virtual ~RawContainer();
+
+    /** Preallocates the file for _capacity frames **/
+    bool    open(const std::string& _path, int _width, int _height, bool _half, size_t _capacity);
+    bool    isOpen() const { return m_data != nullptr; }
+    void    close();
+
+    /** Copies a bottom-up RGBA frame in _slot. Different slots can be written from different threads **/
+    bool    write(size_t _slot, int _frame, float _time, const unsigned char* _rgba);
+
+    const std::string& getPath() const { return m_path; }
+    size_t  getCapacity() const { return m_capacity; }
+
+protected:
+    std::string     m_path;
+    unsigned char*  m_data;
+    size_t          m_size;
+    size_t          m_capacity;
+    size_t          m_frameSize;
+    std::atomic<size_t> m_count;
+    int             m_width;
+    int             m_height;
+    bool            m_half;
+    int             m_fd;
+};
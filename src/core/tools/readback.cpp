@@ -0,0 +1,139 @@
+#include "readback.h"
+
+#include <iostream>
+#include <algorithm>
+
+ReadbackRing::ReadbackRing(): m_tail(0), m_pending(0), m_width(0), m_height(0), m_channels(4) {
+}
+
+ReadbackRing::~ReadbackRing() {
+    clear();
+}
+
+bool ReadbackRing::isAllocated(int _width, int _height, int _channels) const {
+    return m_width == _width && m_height == _height && m_channels == _channels;
+}
+
+bool ReadbackRing::allocate(int _width, int _height, int _channels, size_t _depth) {
+    clear();
+
+    if (_width <= 0 || _height <= 0)
+        return false;
+
+    m_width = _width;
+    m_height = _height;
+    m_channels = _channels;
+    m_slots.resize( std::max(_depth, (size_t)1) );
+
+    #if defined(SUPPORT_ASYNC_READBACK)
+    const GLsizeiptr size = (GLsizeiptr)m_width * m_height * m_channels;
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        glGenBuffers(1, &m_slots[i].pbo);
+        glBindBuffer(GL_PIXEL_PACK_BUFFER, m_slots[i].pbo);
+        glBufferData(GL_PIXEL_PACK_BUFFER, size, NULL, GL_STREAM_READ);
+    }
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    #else
+    m_pixels.resize( (size_t)m_width * m_height * m_channels );
+    #endif
+
+    return true;
+}
+
+void ReadbackRing::clear() {
+    #if defined(SUPPORT_ASYNC_READBACK)
+    for (size_t i = 0; i < m_slots.size(); i++) {
+        if (m_slots[i].fence)
+            glDeleteSync(m_slots[i].fence);
+        if (m_slots[i].pbo)
+            glDeleteBuffers(1, &m_slots[i].pbo);
+    }
+    #endif
+
+    m_slots.clear();
+    m_pixels.clear();
+    m_tail = 0;
+    m_pending = 0;
+    m_width = 0;
+    m_height = 0;
+}
+
+bool ReadbackRing::read(const std::string& _file, const ReadbackCallback& _callback) {
+    if (!isAllocated())
+        return false;
+
+    GLenum format = (m_channels == 3)? GL_RGB : GL_RGBA;
+
+    // rows of RGB frames are not 4 bytes aligned
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+    #if defined(SUPPORT_ASYNC_READBACK)
+    // The ring is full, the oldest frame needs to leave before reusing its buffer
+    if (m_pending == m_slots.size())
+        _deliver(m_tail, _callback, true);
+
+    size_t index = (m_tail + m_pending) % m_slots.size();
+    Slot& slot = m_slots[index];
+    slot.file = _file;
+
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    glReadPixels(0, 0, m_width, m_height, format, GL_UNSIGNED_BYTE, 0);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+    slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+    m_pending++;
+
+    #else
+    glReadPixels(0, 0, m_width, m_height, format, GL_UNSIGNED_BYTE, &m_pixels[0]);
+    _callback(_file, m_width, m_height, m_channels, &m_pixels[0]);
+    #endif
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 4);
+    return true;
+}
+
+size_t ReadbackRing::collect(const ReadbackCallback& _callback, bool _wait) {
+    size_t delivered = 0;
+    while (m_pending > 0) {
+        if ( !_deliver(m_tail, _callback, _wait) )
+            break;
+        delivered++;
+    }
+    return delivered;
+}
+
+bool ReadbackRing::_deliver(size_t _index, const ReadbackCallback& _callback, bool _wait) {
+    #if defined(SUPPORT_ASYNC_READBACK)
+    Slot& slot = m_slots[_index];
+
+    if (slot.fence) {
+        GLenum status = glClientWaitSync(slot.fence, 0, 0);
+        while (_wait && status == GL_TIMEOUT_EXPIRED)
+            status = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+
+        if (status == GL_TIMEOUT_EXPIRED)
+            return false;
+        else if (status == GL_WAIT_FAILED)
+            std::cerr << "Readback fence of " << slot.file << " failed, reading it anyway" << std::endl;
+
+        glDeleteSync(slot.fence);
+        slot.fence = 0;
+    }
+
+    const GLsizeiptr size = (GLsizeiptr)m_width * m_height * m_channels;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.pbo);
+    const unsigned char* pixels = (const unsigned char*)glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+    if (pixels) {
+        _callback(slot.file, m_width, m_height, m_channels, pixels);
+        glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    }
+    else
+        std::cerr << "Can't map the pixels of " << slot.file << std::endl;
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    slot.file = "";
+    m_tail = (m_tail + 1) % m_slots.size();
+    m_pending--;
+    #endif
+
+    return true;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include <functional>
+
+#include "vera/gl/gl.h"
+
+// Pixel pack buffers and fences are only present on GL 3.x / GLES 3.x headers.
+// WebGL can't map buffers, so there it falls back to a synchronous glReadPixels
+#if defined(GL_PIXEL_PACK_BUFFER) && defined(GL_SYNC_GPU_COMMANDS_COMPLETE) && !defined(__EMSCRIPTEN__)
+#define SUPPORT_ASYNC_READBACK
+#endif
+
+/** Called once the pixels of a frame are ready on the CPU side.
+ *  The data is only valid during the call, copy it if you need to keep it. **/
+typedef std::function<void(const std::string& _file, int _width, int _height, int _channels, const unsigned char* _pixels)> ReadbackCallback;
+
+/** Ring of N pixel pack buffers. Reading frame K is queued on the GPU
+ *  and only mapped once its fence has signalled, so it overlaps with the
+ *  rendering of frame K+1 instead of stalling the pipeline. **/
+class ReadbackRing {
+public:
+    ReadbackRing();
+    virtual ~ReadbackRing();
+
+    bool    allocate(int _width, int _height, int _channels, size_t _depth = 3);
+    bool    isAllocated() const { return m_width > 0 && m_height > 0; }
+    bool    isAllocated(int _width, int _height, int _channels) const;
+    void    clear();
+
+    /** queue the read of the currently bound framebuffer. If the ring is full the oldest frame is delivered first **/
+    bool    read(const std::string& _file, const ReadbackCallback& _callback);
+
+    /** deliver the frames which fences already signalled. With _wait it blocks until all frames in flight are delivered **/
+    size_t  collect(const ReadbackCallback& _callback, bool _wait = false);
+
+    size_t  getPending() const { return m_pending; }
+    int     getWidth() const { return m_width; }
+    int     getHeight() const { return m_height; }
+    int     getChannels() const { return m_channels; }
+
+protected:
+    bool    _deliver(size_t _index, const ReadbackCallback& _callback, bool _wait);
+
+    struct Slot {
+        std::string file;
+        #if defined(SUPPORT_ASYNC_READBACK)
+        GLuint      pbo     = 0;
+        GLsync      fence   = 0;
+        #endif
+    };
+
+    std::vector<Slot>           m_slots;
+    std::vector<unsigned char>  m_pixels;   // used only on the synchronous fallback
+
+    size_t  m_tail;
+    size_t  m_pending;
+
+    int     m_width;
+    int     m_height;
+    int     m_channels;
+};
@@ -5,13 +5,19 @@
 
 #include <cstdio>
 #include <atomic>
+#include <mutex>
 #include <thread>
 #include <chrono>
+#include <condition_variable>
+#include <cmath>
+#include <algorithm>
 
 #include "vera/ops/fs.h"
 #include "vera/ops/string.h"
 
 #include "lockFreeQueue.h"
+#include "encoder.h"
+#include "yuvPass.h"
 #include "console.h"
 
 #if defined( _WIN32 )
@@ -24,11 +30,20 @@
 
 float fdelta = 0.04166666667f;
 size_t counter = 0;
+size_t offset = 0;      // index of the first frame, when rendering a slice of a longer sequence
+bool record_offline = false;
+bool record_gpuYuv = true;
+SequenceFormat record_format = SEQUENCE_PNG;
+
+// Progress notifications for the threads waiting on the recording (see recordingWaitProgress)
+std::mutex              record_mutex;
+std::condition_variable record_progress;
 
 // PNG Sequence by secs
 float sec_start = 0.0f;
 float sec_head = 0.0f;
 float sec_end = 0.0f;
+size_t sec_frames = 0;
 bool  sec = false;
 
 // PNG Sequence by frames
@@ -51,9 +66,13 @@ RecordingSettings           pipe_settings;
 
 TimePoint                   pipe_start;
 TimePoint                   pipe_lastFrame;
-LockFreeQueue               pipe_frames;
+LockFreeQueue<Pixels>       pipe_frames;
+Encoder                     pipe_encoder;
+std::atomic<bool>           pipe_encoderOpen(false);    // pipe_encoder belongs to the encoder thread while it runs, others ask this
 
-bool recordingPipe() { return (pipe != nullptr && pipe_isRecording.load()); }
+bool recordingPipe() { return ((pipe != nullptr || pipe_encoderOpen.load()) && pipe_isRecording.load()); }
+int  recordingPipeChannels() { return pipe_settings.src_channels; }
+bool recordingPipeYuv() { return recordingPipe() && pipe_settings.src_yuv; }
 
 // From https://github.com/tyhenry/ofxFFmpeg
 bool recordingPipeOpen(const RecordingSettings& _settings, float _start, float _end) {
@@ -94,10 +113,27 @@ bool recordingPipeOpen(const RecordingSettings& _settings, float _start, float _
 
     fdelta = 1.0/pipe_settings.src_fps;
     counter = 0;
+    offset = 0;
 
     sec_start = _start;
     sec_head = _start;
     sec_end = _end;
+    sec_frames = recordingSecsToFrames(_start, _end, pipe_settings.src_fps);
+
+    pipe_settings.src_yuv = false;
+    if ( pipe_settings.backend == RECORDING_LIBAV ) {
+        pipe_settings.src_channels = 4;
+        if ( pipe_encoder.open(pipe_settings.trg_path, pipe_settings.src_width, pipe_settings.src_height, pipe_settings.src_fps, pipe_settings.trg_crf) ) {
+            pipe_settings.src_yuv = record_gpuYuv && YuvPass::isSupported(pipe_settings.src_width, pipe_settings.src_height);
+            if ( record_gpuYuv && !pipe_settings.src_yuv )
+                std::cout << "GPU YUV needs a width multiple of 8 and a height multiple of 4, converting on CPU." << std::endl;
+            pipe_encoderOpen = true;
+            return pipe_isRecording = true;
+        }
+
+        std::cerr << "Can't encode " << pipe_settings.trg_path << " directly, falling back to ffmpeg." << std::endl;
+    }
+    pipe_settings.src_channels = 3;
 
     std::string cmd = pipe_settings.ffmpegPath;
     std::vector<std::string> args = {
@@ -147,44 +183,64 @@ bool recordingPipeOpen(const RecordingSettings& _settings, float _start, float _
 }
 
 void processFrame() {
-    while ( pipe_isRecording.load() ) {
+    const bool  offline     = isRecordingOffline();
+    const float framedur    = 1.f / pipe_settings.src_fps;
+    TimePoint   lastFrameTime = Clock::now();
 
-        TimePoint lastFrameTime = Clock::now();
-        const float framedur    = 1.f / pipe_settings.src_fps;
+    // allows finish processing queue after we call stop()
+    while ( pipe_isRecording.load() || !pipe_frames.empty() ) {
 
-        while ( pipe_frames.size() ) {  // allows finish processing queue after we call stop()
+        // Sleep until a frame arrives. The timeout is there only to notice when the recording stops
+        Pixels pixels;
+        if ( !pipe_frames.consumeWait( pixels, std::chrono::milliseconds(100) ) || !pixels )
+            continue;
 
-            // feed frames at constant fps
+        // Live capture feeds frames at constant fps, offline renders go as fast as ffmpeg takes them
+        if ( !offline ) {
             float delta = Seconds( Clock::now() - lastFrameTime ).count();
+            if ( delta < framedur )
+                std::this_thread::sleep_for( Seconds(framedur - delta) );
+        }
 
-            if ( delta >= framedur ) {
-                
-                if ( !pipe_isRecording.load() ) {
-                    console_clear();
-                    std::cout << "Don't close. Recording stopped, but still processing " << pipe_frames.size() << " frames" << std::endl;
-                }
+        if ( !pipe_isRecording.load() ) {
+            console_clear();
+            std::cout << "Don't close. Recording stopped, but still processing " << pipe_frames.size() << " frames" << std::endl;
+        }
 
-                Pixels pixels;
-                if ( pipe_frames.consume( std::move( pixels ) ) && pixels ) {
-                    std::unique_ptr<unsigned char[]> data = std::move( pixels );
-                    const size_t dataLength = pipe_settings.src_width * pipe_settings.src_height * pipe_settings.src_channels;
-                    const size_t written = pipe ? fwrite( data.get(), sizeof( char ), dataLength, pipe ) : 0;
+        size_t written = 0;
+        if ( pipe_encoder.isOpen() )
+            written = ( pipe_settings.src_yuv ? pipe_encoder.encodeYuv( pixels.get() ) : pipe_encoder.encode( pixels.get() ) ) ? 1 : 0;
+        else if ( pipe ) {
+            const size_t dataLength = pipe_settings.src_width * pipe_settings.src_height * pipe_settings.src_channels;
+            written = fwrite( pixels.get(), sizeof( char ), dataLength, pipe );
+        }
+        // give the buffer back to the pool as soon as possible
+        pixels.reset();
 
-                    if ( written <= 0 )
-                        std::cout << "Unable to write the frame." << std::endl;
+        if ( written <= 0 )
+            std::cout << "Unable to write the frame." << std::endl;
 
-                    lastFrameTime = Clock::now();
-                }
+        lastFrameTime = Clock::now();
+        console_refresh();
+    }
 
-                console_refresh();
-            }
-        }
+    console_clear();
+    std::cout << "Don't close. Encoding data into " << pipe_settings.trg_path << std::endl;
+    console_refresh();
+
+    if ( pipe_encoder.isOpen() ) {
+        size_t frames = pipe_encoder.getFrames();
+        double average = pipe_encoder.getLatencyAverage();
+        double max = pipe_encoder.getLatencyMax();
+        pipe_encoderOpen = false;
+        pipe_encoder.close();
 
         console_clear();
-        std::cout << "Don't close. Encoding data into " << pipe_settings.trg_path << std::endl;
+        std::cout << "Finish saving " << pipe_settings.trg_path << " (" << frames << " frames, ";
+        std::cout << average << "ms per frame, " << max << "ms max)" << std::endl;
         console_refresh();
-
     }
+
     // close ffmpeg pipe once stopped recording
     
     
@@ -206,13 +262,13 @@ void processFrame() {
     counter = 0;
 }
 
-size_t recordingPipeFrame( std::unique_ptr<unsigned char[]>&& _pixels ) {
+size_t recordingPipeFrame( Pixels&& _pixels ) {
     if ( !pipe_isRecording ) {
         std::cerr << "Can't add new frame - not in recording mode." << std::endl;
         return 0;
     }
 
-    if ( !pipe ) {
+    if ( !pipe && !pipe_encoderOpen.load() ) {
         std::cerr << "Can't add new frame - FFmpeg pipe is invalid!" << std::endl;
         return 0;
     }
@@ -224,6 +280,7 @@ size_t recordingPipeFrame( std::unique_ptr<unsigned char[]>&& _pixels ) {
         pipe_lastFrame  = pipe_start;
     }
 
+    // blocks if the encoder falls behind
     pipe_frames.produce( std::move(_pixels) );
     pipe_lastFrame = Clock::now();
 
@@ -266,28 +323,48 @@ void recordingPipeClose() {
 
     if ( pipe != nullptr )
         P_CLOSE( pipe );
+
+    pipe_encoderOpen = false;
+    pipe_encoder.close();
 }
 
 #else
 
 bool    recordingPipe() { return false; };
+int     recordingPipeChannels() { return 4; };
+bool    recordingPipeYuv() { return false; };
 #endif
 
 // ---------------------------------------------------------------------------
 
+size_t recordingSecsToFrames(float _start, float _end, float _fps) {
+    // the small epsilon keeps exact multiples (ex. 2 secs at 24fps) from getting an extra frame
+    double frames = std::ceil( ((double)_end - (double)_start) * (double)_fps - 1e-4 );
+    return (size_t)std::max(1.0, frames);
+}
+
 void recordingStartSecs(float _start, float _end, float _fps) {
+    recordingStartSlice(_start, _fps, 0, recordingSecsToFrames(_start, _end, _fps));
+}
+
+void recordingStartSlice(float _origin, float _fps, int _first, int _last) {
+    std::lock_guard<std::mutex> lock(record_mutex);
     fdelta = 1.0/_fps;
     counter = 0;
+    offset = _first;
 
-    sec_start = _start;
-    sec_head = _start;
-    sec_end = _end;
+    sec_start = _origin;
+    sec_head = _origin + _first * fdelta;
+    sec_end = _origin + _last * fdelta;
+    sec_frames = (_last > _first)? _last - _first : 1;
     sec = true;
 }
 
 void recordingStartFrames(int _start, int _end, float _fps) {
+    std::lock_guard<std::mutex> lock(record_mutex);
     fdelta = 1.0/_fps;
     counter = 0;
+    offset = 0;
 
     frame_start = _start;
     frame_head = _start;
@@ -296,17 +373,20 @@ void recordingStartFrames(int _start, int _end, float _fps) {
 }
 
 void recordingFrameAdded() {
+    std::unique_lock<std::mutex> lock(record_mutex);
     counter++;
 
     if (sec) {
-        sec_head += fdelta;
-        if (sec_head >= sec_end)
+        // computed from the frame index instead of accumulated, so any slice of a sequence
+        // gets exactly the same times as rendering it whole
+        sec_head = sec_start + (offset + counter) * fdelta;
+        if (counter >= sec_frames)
             sec = false;
     }
     #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
     else if (recordingPipe()) {
-        sec_head += fdelta;
-        if (sec_head >= sec_end)
+        sec_head = sec_start + counter * fdelta;
+        if (counter >= sec_frames)
             pipe_isRecording = false;
     }
     #endif
@@ -315,16 +395,76 @@ void recordingFrameAdded() {
         if (frame_head >= frame_end)
             frame = false;
     }
+
+    lock.unlock();
+    record_progress.notify_all();
+}
+
+float recordingWaitProgress(float _pct, size_t _timeoutMs) {
+    // Wake up at least every 1% (or at the end) so the progress bar doesn't cost a wake up per frame
+    std::unique_lock<std::mutex> lock(record_mutex);
+    record_progress.wait_for(lock, std::chrono::milliseconds(_timeoutMs), [_pct]() {
+        return !isRecording() || getRecordingPercentage() >= _pct + 0.01f;
+    });
+    return getRecordingPercentage();
+}
+
+void setRecordingOffline(bool _offline) { record_offline = _offline; }
+bool isRecordingOffline() { return record_offline; }
+
+const char* sequence_formats[] = { "png", "raw", "raw_half", "container", "container_half" };
+const char* sequence_exts[] = { "png", "raw", "rawh", "gvr", "gvr" };
+
+bool setSequenceFormat(const std::string& _name) {
+    for (int i = 0; i <= SEQUENCE_CONTAINER_HALF; i++)
+        if (_name == sequence_formats[i]) {
+            record_format = (SequenceFormat)i;
+            return true;
+        }
+    return false;
+}
+
+SequenceFormat  getSequenceFormat() { return record_format; }
+std::string     getSequenceFormatName() { return sequence_formats[record_format]; }
+std::string     getSequenceExt() { return sequence_exts[record_format]; }
+bool            isSequenceContainer() { return record_format == SEQUENCE_CONTAINER || record_format == SEQUENCE_CONTAINER_HALF; }
+
+void setRecordingGpuYuv(bool _gpu) { record_gpuYuv = _gpu; }
+bool isRecordingGpuYuv() { return record_gpuYuv; }
+
+// true when the next call to recordingFrameAdded() will end the recording
+bool isRecordingLastFrame() {
+    if (sec || recordingPipe())
+        return counter + 1 >= sec_frames;
+    else if (frame)
+        return frame_head + 1 >= frame_end;
+    return false;
 }
 
 bool isRecording() { return sec || frame || recordingPipe(); }
 
-int getRecordingCount() { return counter; }
+int getRecordingCount() { return offset + counter; }
+
+int getRecordingTotal() {
+    if (sec || recordingPipe())
+        return sec_frames;
+    else if (frame)
+        return frame_end - frame_start;
+    return 0;
+}
+
+// time of the frame named _index (see getRecordingCount)
+float getRecordingTimeOf(int _index) {
+    if (sec || recordingPipe())
+        return sec_start + _index * fdelta;
+    else
+        return (frame_start + _index) * fdelta;
+}
 float getRecordingDelta() { return fdelta; }
 
 float getRecordingPercentage() {
     if (sec || recordingPipe() )
-        return ((sec_head - sec_start) / (sec_end - sec_start));
+        return (float)counter / (float)sec_frames;
     else if (frame)
         return ( (float)(frame_head - frame_start) / (float)(frame_end - frame_start));
     else 
@@ -333,7 +473,7 @@ float getRecordingPercentage() {
 
 int getRecordingFrame() {
     if (sec || recordingPipe() ) 
-        return (int)(sec_start / fdelta) + counter;
+        return (int)std::lround(sec_start / fdelta) + offset + counter;
     else
         return frame_head;
     
@@ -3,13 +3,23 @@
 #include <string>
 #include <memory>
 
+#include "pixelPool.h"
+
 #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
+enum RecordingBackend {
+    RECORDING_PIPE = 0,     // popen an external ffmpeg and feed it rgb24 frames
+    RECORDING_LIBAV         // encode in-process with libavcodec (falls back to the pipe if it can't)
+};
+
 struct RecordingSettings {
+    RecordingBackend backend    = RECORDING_PIPE;
+
     std::string ffmpegPath      = "ffmpeg";
     std::string src_args        = "";
     size_t      src_width       = 512;
     size_t      src_height      = 512;
     size_t      src_channels    = 3;
+    bool        src_yuv         = false;    // frames come already as planar YUV 4:2:0 (see YuvPass)
     float       src_fps         = 24.0f;
 
     size_t      trg_width       = 512;
@@ -18,23 +28,57 @@ struct RecordingSettings {
 
     std::string trg_args        = "-pix_fmt yuv420p -vsync 1 -g 1";  // -crf 0 -preset ultrafast -tune zerolatency setpts='(RTCTIME - RTCSTART) / (TB * 1000000)'
     std::string trg_path        = "output.mp4";
+    int         trg_crf         = 10;   // only used by RECORDING_LIBAV
 };
 
 bool    recordingPipeOpen(const RecordingSettings& _settings, float _start, float _end);
-size_t  recordingPipeFrame( std::unique_ptr<unsigned char[]>&& _pixels );
+size_t  recordingPipeFrame( Pixels&& _pixels );
 void    recordingPipeClose();
 #endif
 bool    recordingPipe();
+int     recordingPipeChannels();
+bool    recordingPipeYuv();
+
+// Convert frames to YUV 4:2:0 on the GPU before reading them back (only for the libav backend)
+void    setRecordingGpuYuv(bool _gpu);
+bool    isRecordingGpuYuv();
+
+// What sequences save each frame as
+enum SequenceFormat {
+    SEQUENCE_PNG = 0,
+    SEQUENCE_RAW,               // one raw RGBA8 file per frame (.raw)
+    SEQUENCE_RAW_HALF,          // one raw RGBA16F file per frame (.rawh)
+    SEQUENCE_CONTAINER,         // all RGBA8 frames in one indexed file (.gvr)
+    SEQUENCE_CONTAINER_HALF     // all RGBA16F frames in one indexed file (.gvr)
+};
+
+bool            setSequenceFormat(const std::string& _name);
+SequenceFormat  getSequenceFormat();
+std::string     getSequenceFormatName();
+std::string     getSequenceExt();
+bool            isSequenceContainer();
+
+// Offline recordings don't pace frames to the wall clock (ex. headless renders)
+void    setRecordingOffline(bool _offline);
+bool    isRecordingOffline();
 
+size_t  recordingSecsToFrames(float _start, float _end, float _fps);
 void    recordingStartSecs(float _start, float _end, float _fps);
+// Renders only the frames [_first, _last) of a sequence starting at _origin secs, naming them by their global index
+void    recordingStartSlice(float _origin, float _fps, int _first, int _last);
 void    recordingStartFrames(int _start, int _end, float _fps);
 
 void    recordingFrameAdded();
+// Blocks until the recording moves forward from _pct (or ends) and returns the new percentage
+float   recordingWaitProgress(float _pct, size_t _timeoutMs = 250);
+bool    isRecordingLastFrame();
 
 bool    isRecording();
 
 float   getRecordingPercentage();
 int     getRecordingCount();
+int     getRecordingTotal();
+float   getRecordingTimeOf(int _index);
 float   getRecordingDelta();
 int     getRecordingFrame();
 float   getRecordingTime();
\ No newline at end of file
@@ -0,0 +1,138 @@
+#include "sequenceWorkers.h"
+
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <sstream>
+#include <iomanip>
+#include <cstdlib>
+#include <iostream>
+#include <algorithm>
+
+#include "vera/ops/fs.h"
+#include "vera/ops/string.h"
+
+#include "record.h"
+#include "console.h"
+
+#if defined( _WIN32 )
+#define NULL_OUTPUT " > NUL"
+#else
+#define NULL_OUTPUT " > /dev/null"
+#endif
+
+// Floats go to the workers as text, so they need all their digits to produce the same times
+std::string toExactString(float _value) {
+    std::ostringstream out;
+    out << std::setprecision(9) << _value;
+    return out.str();
+}
+
+std::string shellQuote(const std::string& _arg) {
+    #if defined( _WIN32 )
+    return "\"" + _arg + "\"";
+    #else
+    std::string rta = "'";
+    for (size_t i = 0; i < _arg.size(); i++) {
+        if (_arg[i] == '\'')
+            rta += "'\\''";
+        else
+            rta += _arg[i];
+    }
+    return rta + "'";
+    #endif
+}
+
+bool sequenceWorkers(   const std::vector<std::string>& _args,
+                        float _from, float _to, float _fps, int _workers,
+                        const std::string& _video) {
+    #if defined(__EMSCRIPTEN__)
+    std::cout << "Parallel sequences are not supported on this platform" << std::endl;
+    return false;
+    #else
+    if (_args.empty() || _workers < 1 || _fps <= 0.0f)
+        return false;
+
+    const int total = (int)recordingSecsToFrames(_from, _to, _fps);
+    _workers = std::min(_workers, total);
+
+    std::string cmd;
+    for (size_t i = 0; i < _args.size(); i++)
+        cmd += shellQuote(_args[i]) + " ";
+    cmd += "--headless --noncurses ";
+    if (getSequenceFormat() != SEQUENCE_PNG)
+        cmd += "-e " + shellQuote("sequence_format," + getSequenceFormatName()) + " ";
+    cmd += "-E ";
+
+    // each worker of a container sequence writes its own container, named after its first frame
+    const std::string ext = getSequenceExt();
+    const bool perFrame = !isSequenceContainer();
+
+    // Contiguous slices, so each worker keeps its streams and frame to frame state coherent
+    std::vector<int>            first(_workers);
+    std::vector<int>            last(_workers);
+    std::vector<int>            done(_workers);
+    std::vector<std::thread>    workers;
+    std::atomic<int>            running(_workers);
+    std::atomic<int>            failed(0);
+
+    for (int i = 0; i < _workers; i++) {
+        first[i] = (int)(((long long)total * i) / _workers);
+        last[i] = (int)(((long long)total * (i + 1)) / _workers);
+        done[i] = first[i];
+
+        std::string slice = "sequence_slice," + toExactString(_from) + "," + toExactString(_fps) + ",";
+        slice += vera::toString(first[i]) + "," + vera::toString(last[i]);
+        std::string workerCmd = cmd + shellQuote(slice) + NULL_OUTPUT;
+
+        workers.push_back( std::thread([workerCmd, &running, &failed]() {
+            if (std::system(workerCmd.c_str()) != 0)
+                failed++;
+            running--;
+        }) );
+    }
+
+    // The progress is the amount of frames already on disk, or of workers done for containers
+    while (running.load() > 0) {
+        float pct = 1.0f - (float)running.load() / (float)_workers;
+        if (perFrame) {
+            int saved = 0;
+            for (int i = 0; i < _workers; i++) {
+                while (done[i] < last[i] && vera::urlExists( vera::toString(done[i], 0, 5, '0') + "." + ext ))
+                    done[i]++;
+                saved += done[i] - first[i];
+            }
+            pct = (float)saved / (float)total;
+        }
+        console_draw_pct( pct );
+        std::this_thread::sleep_for(std::chrono::milliseconds(100));
+    }
+
+    for (size_t i = 0; i < workers.size(); i++)
+        workers[i].join();
+    console_draw_pct(1.0f);
+
+    if (failed.load() > 0) {
+        std::cerr << failed.load() << " of " << _workers << " workers failed rendering their frames" << std::endl;
+        return false;
+    }
+
+    if (_video.empty())
+        return true;
+
+    if (ext != "png") {
+        std::cerr << "Only PNG sequences can be merged into a video, convert the " << ext << " frames first with raw_convert" << std::endl;
+        return false;
+    }
+
+    std::string merge = "ffmpeg -y -loglevel error -framerate " + toExactString(_fps) + " -start_number 0 -i %05d.png";
+    merge += " -c:v libx264 -crf 10 -pix_fmt yuv420p " + shellQuote(_video);
+    if (std::system(merge.c_str()) != 0) {
+        std::cerr << "Unable to merge the sequence into " << _video << std::endl;
+        return false;
+    }
+
+    std::cout << "Sequence saved to " << _video << std::endl;
+    return true;
+    #endif
+}
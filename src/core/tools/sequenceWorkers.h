@@ -0,0 +1,14 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+/** Renders the sequence [_from, _to) at _fps splitting the frames in _workers contiguous slices,
+ *  each rendered by a headless copy of glslViewer launched with _args (executable first) plus
+ *  a `sequence_slice` command, in the current sequence format.
+ *  Frames are named by their global index (00000.png, 00001.png...) so
+ *  the result is the same sequence a single process would save. If _video is not empty the frames
+ *  are merged into it with ffmpeg once all workers are done. Blocks until then. **/
+bool sequenceWorkers(   const std::vector<std::string>& _args,
+                        float _from, float _to, float _fps, int _workers,
+                        const std::string& _video = "");
@@ -233,6 +233,12 @@ int countDevLookBillboards(const std::string& _source) {
     return generic_search_count(_source, regex_count_t::DevLook_Billboards);
 }
 
+const std::string& indexedName(std::vector<std::string>& _names, const char* _prefix, size_t _index) {
+    while (_names.size() <= _index)
+        _names.push_back(_prefix + vera::toString(_names.size()));
+    return _names[_index];
+}
+
 std::string getUniformName(const std::string& _str) {
     std::vector<std::string> values = vera::split(_str, '.');
     return "u_" + vera::toLower( vera::toUnderscore( vera::purifyString( values[0] ) ) );
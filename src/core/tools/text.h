@@ -1,6 +1,7 @@
 #pragma once
 
 #include <string>
+#include <vector>
 #include "glm/glm.hpp"
 
 // Search for one apearance
@@ -27,4 +28,7 @@ bool checkNormalBuffer(const std::string& _source);
 int  countSceneBuffers(const std::string& _source);
 
 int  countDevLookBillboards(const std::string& _source);
-int  countDevLookSpheres(const std::string& _source);
\ No newline at end of file
+int  countDevLookSpheres(const std::string& _source);
+
+// _prefix followed by _index ("u_buffer0", "u_buffer1"...), built the first time and kept on _names
+const std::string& indexedName(std::vector<std::string>& _names, const char* _prefix, size_t _index);
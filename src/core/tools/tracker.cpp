@@ -1,9 +1,47 @@
 #include "tracker.h"
 
+#include <sstream>
+#include <iomanip>
+
+#include "vera/gl/gl.h"
 #include "vera/ops/string.h"
 
-Tracker::Tracker() {
+void StatSketch::clear() {
+    buckets.assign(TRACKER_SKETCH_BUCKETS, 0);
+    count = 0;
+    sum = 0.0;
+    max = 0.0;
+    lastStartMs = 0.0;
+    intervals = 0;
+    intervalMean = 0.0;
+    intervalM2 = 0.0;
+}
 
+double StatSketch::quantile(double _q) const {
+    if (count == 0)
+        return 0.0;
+
+    size_t target = (size_t)std::ceil(_q * (double)count);
+    if (target < 1)
+        target = 1;
+
+    size_t seen = 0;
+    for (size_t i = 0; i < buckets.size(); i++) {
+        seen += buckets[i];
+        if (seen >= target) {
+            // middle of the bucket, but never past the highest sample
+            int exp = (int)(i / TRACKER_SKETCH_STEPS) + TRACKER_SKETCH_MIN_EXP;
+            double step = (double)(i % TRACKER_SKETCH_STEPS);
+            double value = std::ldexp(0.5 + (step + 0.5) / (2.0 * TRACKER_SKETCH_STEPS), exp);
+            return (value < max)? value : max;
+        }
+    }
+    return max;
+}
+
+Tracker::Tracker() {
+    m_tracks.reserve(TRACKER_MAX_TRACKS);
+    m_frameTrack = getTrackId("frame");
 }
 
 Tracker::~Tracker() {
@@ -11,126 +49,355 @@ Tracker::~Tracker() {
 }
 
 void Tracker::start() {
-    m_data.clear();
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // ids stay valid, only their samples are dropped
+    for (size_t i = 0; i < m_tracks.size(); i++) {
+        m_tracks[i].samples.resize(TRACKER_RING_SIZE);
+        m_tracks[i].start = StatPoint();
+        m_tracks[i].head = 0;
+        m_tracks[i].count = 0;
+        m_tracks[i].stats.clear();
+    }
 
-    auto start = std::chrono::high_resolution_clock::now();
-    m_trackerStart = std::chrono::time_point_cast<std::chrono::microseconds>(start).time_since_epoch().count() * 0.001;
+    // timers still in flight belong to samples that are gone
+    m_session++;
+    m_trackerStart = StatClock::now();
     m_running = true;
 }
 
-void Tracker::begin(const std::string& _track) {
-    if (!m_running)
+void Tracker::stop() {
+    m_running = false;
+}
+
+int Tracker::getTrackId(const std::string& _track) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_map<std::string, int>::iterator it = m_ids.find(_track);
+    if (it != m_ids.end())
+        return it->second;
+
+    if (m_tracks.size() >= TRACKER_MAX_TRACKS) {
+        std::cerr << "Too many tracks, " << _track << " won't be tracked" << std::endl;
+        m_ids[_track] = -1;
+        return -1;
+    }
+
+    StatTrack track;
+    track.name = _track;
+    track.head = 0;
+    track.count = 0;
+    track.durationAverage = 0.0;
+    track.gpuQuery = 0;
+    track.counter = false;
+    if (m_running) {
+        track.samples.resize(TRACKER_RING_SIZE);
+        track.stats.clear();
+    }
+
+    int id = (int)m_tracks.size();
+    m_tracks.push_back(track);
+    m_ids[_track] = id;
+    return id;
+}
+
+void Tracker::record(int _id, const StatPoint& _start, const StatPoint& _end) {
+    if (!isRunning() || _id < 0)
         return;
 
-    if ( m_data.find(_track) == m_data.end() )
-        m_tracks.push_back(_track);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    StatTrack& track = m_tracks[_id];
+    if (track.samples.empty() || _start < m_trackerStart)
+        return;
 
-    m_data[_track].start = std::chrono::high_resolution_clock::now();
+    _add(track, _start, _end);
 }
 
-void Tracker::end(const std::string& _track) {
-    if (!m_running)
+void Tracker::counter(int _id, double _value) {
+    if (!isRunning() || _id < 0)
         return;
 
-    auto sample_end = std::chrono::high_resolution_clock::now();
+    StatPoint now = StatClock::now();
 
-    if ( m_data.find(_track) == m_data.end() )
-        m_tracks.push_back(_track);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    StatTrack& track = m_tracks[_id];
+    if (track.samples.empty())
+        return;
 
-    auto start = std::chrono::time_point_cast<std::chrono::microseconds>(m_data[_track].start).time_since_epoch();
-    auto end = std::chrono::time_point_cast<std::chrono::microseconds>(sample_end).time_since_epoch();
-    
-    StatSample stat;
-    stat.startMs = start.count() * 0.001 - m_trackerStart;
-    stat.endMs = end.count() * 0.001 - m_trackerStart;
-    stat.durationMs = stat.endMs - stat.startMs;
+    track.counter = true;
+    _add(track, now, now).durationMs = _value;
+}
 
-    if (stat.startMs > 0)
-        m_data[_track].samples.push_back( stat );
+void Tracker::setThreadName(const std::string& _name) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_threadNames[trackerThreadId()] = _name;
 }
 
-void Tracker::stop() {
-    m_running = false;
+unsigned int Tracker::_gpuQuery() {
+    #if defined(GL_TIMESTAMP)
+    if (m_gpuFree.empty()) {
+        if (m_gpuQueries >= TRACKER_MAX_QUERIES)
+            return 0;
+
+        GLuint queries[64];
+        glGenQueries(64, queries);
+        m_gpuFree.insert(m_gpuFree.end(), queries, queries + 64);
+        m_gpuQueries += 64;
+    }
+
+    unsigned int query = m_gpuFree.back();
+    m_gpuFree.pop_back();
+    return query;
+    #else
+    return 0;
+    #endif
 }
 
-double  Tracker::getFramerate() {
-    double frm = 0.0;
-    int count = 0;
-    for (std::map<std::string, StatTrack>::iterator it = m_data.begin() ; it != m_data.end(); ++it) {   
-        double delta = 0.0;
-        for (size_t i = 1; i < it->second.samples.size(); i++) 
-            delta += (it->second.samples[i].startMs - it->second.samples[i-1].startMs);
-        
-        delta /= (double) (it->second.samples.size() - 1);
-        frm += delta;
-        count++;
+void Tracker::_gpuBegin(StatTrack& _track) {
+    #if defined(GL_TIMESTAMP)
+    if (m_gpuSupported < 0) {
+        GLint bits = 0;
+        glGetQueryiv(GL_TIMESTAMP, GL_QUERY_COUNTER_BITS, &bits);
+        m_gpuSupported = bits > 0;
+    }
+    #else
+    m_gpuSupported = 0;
+    #endif
+
+    if (!m_gpuSupported) {
+        std::cout << "GPU timer queries are not supported, tracking CPU time only" << std::endl;
+        m_gpu = false;
+        return;
     }
 
-    return ( frm / (double)count );
+    #if defined(GL_TIMESTAMP)
+    // begun again without an end
+    if (_track.gpuQuery != 0)
+        m_gpuFree.push_back(_track.gpuQuery);
+
+    _track.gpuQuery = _gpuQuery();
+    if (_track.gpuQuery != 0)
+        glQueryCounter(_track.gpuQuery, GL_TIMESTAMP);
+    #endif
+}
+
+void Tracker::_gpuEnd(int _id, StatTrack& _track, size_t _sample) {
+    #if defined(GL_TIMESTAMP)
+    if (_track.gpuQuery == 0)
+        return;
+
+    GpuQuery query;
+    query.track = _id;
+    query.sample = _sample;
+    query.begin = _track.gpuQuery;
+    query.end = _gpuQuery();
+    query.session = m_session;
+    _track.gpuQuery = 0;
+
+    if (query.end == 0) {
+        m_gpuFree.push_back(query.begin);
+        return;
+    }
+
+    glQueryCounter(query.end, GL_TIMESTAMP);
+    m_gpuPending.push_back(query);
+    #endif
+}
+
+void Tracker::collect() {
+    #if defined(GL_TIMESTAMP)
+    // queries finish in the order they were issued, stop at the first one that isn't ready
+    while (!m_gpuPending.empty()) {
+        GpuQuery& query = m_gpuPending.front();
+
+        GLint available = 0;
+        glGetQueryObjectiv(query.end, GL_QUERY_RESULT_AVAILABLE, &available);
+        if (!available)
+            break;
+
+        GLuint64 begin = 0;
+        GLuint64 end = 0;
+        glGetQueryObjectui64v(query.begin, GL_QUERY_RESULT, &begin);
+        glGetQueryObjectui64v(query.end, GL_QUERY_RESULT, &end);
+
+        // unless start() dropped it or the ring already overwrote it
+        StatTrack& track = m_tracks[query.track];
+        if (query.session == m_session && track.count - query.sample <= track.samples.size())
+            track.samples[query.sample % track.samples.size()].gpuMs = (double)(end - begin) * 0.000001;
+
+        m_gpuFree.push_back(query.begin);
+        m_gpuFree.push_back(query.end);
+        m_gpuPending.pop_front();
+    }
+    #endif
+}
+
+std::string traceEscape(const std::string& _text) {
+    std::string rta;
+    for (size_t i = 0; i < _text.size(); i++) {
+        if (_text[i] == '"' || _text[i] == '\\')
+            rta += '\\';
+        rta += _text[i];
+    }
+    return rta;
+}
+
+std::string Tracker::logTrace() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // times are in microseconds, nested spans are the ones inside others of the same thread
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(3);
+    out << "{\"traceEvents\":[\n";
+    out << "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"glslViewer\"}}";
+
+    for (std::map<uint32_t, std::string>::iterator it = m_threadNames.begin(); it != m_threadNames.end(); ++it)
+        out << ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << it->first << ",\"args\":{\"name\":\"" << traceEscape(it->second) << "\"}}";
+
+    for (size_t t = 0; t < m_tracks.size(); t++) {
+        const StatTrack& track = m_tracks[t];
+        std::string name = traceEscape(track.name);
+        std::string category = name.substr(0, name.find(':'));
+
+        for (size_t i = 0; i < track.size(); i++) {
+            const StatSample& sample = track[i];
+            if (track.counter) {
+                out << ",\n{\"name\":\"" << name << "\",\"ph\":\"C\",\"pid\":1,\"tid\":" << sample.thread;
+                out << ",\"ts\":" << sample.startMs * 1000.0 << ",\"args\":{\"value\":" << sample.durationMs << "}}";
+            }
+            else {
+                out << ",\n{\"name\":\"" << name << "\",\"cat\":\"" << category << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << sample.thread;
+                out << ",\"ts\":" << sample.startMs * 1000.0 << ",\"dur\":" << sample.durationMs * 1000.0;
+                if (sample.gpuMs >= 0.0)
+                    out << ",\"args\":{\"gpu_ms\":" << sample.gpuMs << "}";
+                out << "}";
+            }
+        }
+    }
+
+    out << "\n]}\n";
+    return out.str();
+}
+
+void Tracker::frame() {
+    if (!isRunning())
+        return;
+
+    StatPoint now = StatClock::now();
+    if (m_lastFrame >= m_trackerStart) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        _add(m_tracks[m_frameTrack], m_lastFrame, now);
+    }
+    m_lastFrame = now;
+}
+
+double  Tracker::getFramerate() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    double median = m_tracks[m_frameTrack].stats.quantile(0.5);
+    return (median > 0.0)? 1000.0 / median : 0.0;
 }
 
 std::string Tracker::logFramerate() {
-    return  "framerate," + vera::toString(getFramerate()) + "\n";// +
-            // "fps," + vera::toString( (1./getFramerate()) * 1000.0 ) ;
+    return  "framerate," + vera::toString(getFramerate()) + "\n";
+}
+
+std::string Tracker::logStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    std::ostringstream out;
+    out << std::fixed << std::setprecision(4);
+    out << "track,count,meanMs,p50Ms,p95Ms,p99Ms,maxMs,intervalMs,jitterMs\n";
+    for (size_t t = 0; t < m_tracks.size(); t++) {
+        const StatTrack& track = m_tracks[t];
+        const StatSketch& stats = track.stats;
+        if (track.counter || stats.count == 0)
+            continue;
+
+        out << track.name << "," << stats.count << "," << stats.sum / (double)stats.count << ",";
+        out << stats.quantile(0.5) << "," << stats.quantile(0.95) << "," << stats.quantile(0.99) << "," << stats.max << ",";
+        out << stats.intervalMean << "," << stats.jitter() << "\n";
+    }
+    return out.str();
 }
 
 std::string Tracker::logSamples() {
+    std::lock_guard<std::mutex> lock(m_mutex);
     std::string log = "";
 
     for (size_t t = 0; t < m_tracks.size(); t++)
-        log += logSamples(m_tracks[t]);
+        log += _logSamples(m_tracks[t]);
 
     return log;
 }
 
 std::string Tracker::logSamples(const std::string& _track) {
-    std::map<std::string, StatTrack>::iterator it = m_data.find(_track);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_map<std::string, int>::iterator it = m_ids.find(_track);
 
-    if ( it == m_data.end() )
+    if ( it == m_ids.end() || it->second < 0 )
         return "";
 
+    return _logSamples(m_tracks[it->second]);
+}
+
+std::string Tracker::_logSamples(StatTrack& _track) {
     std::string log = "";
-    std::string track_name = it->first;
-    
-    for (size_t i = 0; i < it->second.samples.size(); i++)
-        log +=  track_name + "," + 
-                vera::toString(it->second.samples[i].startMs) + "," + 
-                vera::toString(it->second.samples[i].durationMs) + "\n";
+
+    for (size_t i = 0; i < _track.size(); i++)
+        log +=  _track.name + "," +
+                vera::toString(_track[i].startMs) + "," +
+                vera::toString(_track[i].durationMs) + "\n";
 
     return log;
 }
 
 std::string Tracker::logAverage() {
+    std::lock_guard<std::mutex> lock(m_mutex);
     std::string log = "";
 
     for (size_t t = 0; t < m_tracks.size(); t++)
-        log += logAverage(m_tracks[t]);
+        log += _logAverage(m_tracks[t]);
 
     return log;
 }
 
 std::string Tracker::logAverage(const std::string& _track) {
-    std::map<std::string, StatTrack>::iterator it = m_data.find(_track);
+    std::lock_guard<std::mutex> lock(m_mutex);
+    std::unordered_map<std::string, int>::iterator it = m_ids.find(_track);
+
+    if ( it == m_ids.end() || it->second < 0 )
+        return "";
+
+    return _logAverage(m_tracks[it->second]);
+}
 
-    if ( it == m_data.end() )
+std::string Tracker::_logAverage(StatTrack& _track) {
+    if (_track.size() == 0 || _track.counter)
         return "";
 
     std::string log = "";
-    std::string track_name = it->first;
 
     double average = 0.0;
     double delta = 0.0;
-    for (size_t i = 0; i < it->second.samples.size(); i++) {
-        average += it->second.samples[i].durationMs;
+    double gpu = 0.0;
+    size_t gpuCount = 0;
+    for (size_t i = 0; i < _track.size(); i++) {
+        average += _track[i].durationMs;
         if (i > 0)
-            delta += it->second.samples[i].startMs - it->second.samples[i-1].startMs;
+            delta += _track[i].startMs - _track[i-1].startMs;
+        if (_track[i].gpuMs >= 0.0) {
+            gpu += _track[i].gpuMs;
+            gpuCount++;
+        }
     }
 
-    average /= (double)it->second.samples.size();
-    delta /= (double)it->second.samples.size() - 1.0;
-    it->second.durationAverage = average;
-    
-    log += track_name + "," + vera::toString(average) + "," + vera::toString( (average/delta) * 100.0) + "," + vera::toString(delta) +  "\n";
+    average /= (double)_track.size();
+    delta /= (double)_track.size() - 1.0;
+    _track.durationAverage = average;
+
+    log += _track.name + "," + vera::toString(average) + "," + vera::toString( (average/delta) * 100.0) + "," + vera::toString(delta);
+    if (m_gpu)
+        log += "," + ((gpuCount > 0)? vera::toString(gpu / (double)gpuCount) : std::string("-"));
+    log += "\n";
 
     return log;
 }
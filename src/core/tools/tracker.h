@@ -1,24 +1,114 @@
 #pragma once
 
 #include <map>
+#include <deque>
+#include <mutex>
+#include <atomic>
 #include <vector>
 #include <string>
+#include <cmath>
 #include <chrono>
+#include <cstdint>
 #include <iostream>
+#include <unordered_map>
 
-typedef std::chrono::time_point<std::chrono::high_resolution_clock> StatPoint;
+// Tracks are interned into a table that never reallocates, so ids can be kept by callers
+#define TRACKER_MAX_TRACKS  1024
+// Samples kept per track, older ones are overwritten
+#define TRACKER_RING_SIZE   4096
+// GPU timer queries in flight, past that samples go without GPU time until the GPU catches up
+#define TRACKER_MAX_QUERIES 4096
+
+// Durations are summarized on log buckets: each power of two of milliseconds is split in
+// TRACKER_SKETCH_STEPS, so quantiles are within ~1.5% of the real value, with a fixed memory per track
+#define TRACKER_SKETCH_STEPS    32
+#define TRACKER_SKETCH_MIN_EXP  -10     // 2^-11 ms, half a microsecond
+#define TRACKER_SKETCH_MAX_EXP  20      // 2^20 ms, more than 17 minutes
+#define TRACKER_SKETCH_BUCKETS  ((TRACKER_SKETCH_MAX_EXP - TRACKER_SKETCH_MIN_EXP + 1) * TRACKER_SKETCH_STEPS)
+
+typedef std::chrono::high_resolution_clock              StatClock;
+typedef std::chrono::time_point<StatClock>              StatPoint;
+
+/** Small number that identifies the calling thread on the samples, given on its first call **/
+inline uint32_t trackerThreadId() {
+    static std::atomic<uint32_t> next(1);
+    thread_local uint32_t id = next++;
+    return id;
+}
 
 struct StatSample {
     double       startMs;
     double       endMs;
-    double       durationMs;
+    double       durationMs;    // or the value, on counters
+    double       gpuMs;         // -1 until its timer query is collected, or without them
+    uint32_t     thread;
+};
+
+/** Streaming summary of all the samples of a track since start(), even the ones the ring dropped **/
+struct StatSketch {
+    std::vector<uint32_t>   buckets;
+    size_t                  count;
+    double                  sum;
+    double                  max;
+
+    // interval between the start of consecutive samples, as a running mean and variance (Welford)
+    double                  lastStartMs;
+    size_t                  intervals;
+    double                  intervalMean;
+    double                  intervalM2;
+
+    void    clear();
+
+    void    add(double _durationMs, double _startMs) {
+        int exp = 0;
+        double mantissa = std::frexp(_durationMs, &exp);   // [0.5, 1)
+        size_t index = 0;
+        if (_durationMs <= 0.0 || exp < TRACKER_SKETCH_MIN_EXP)
+            index = 0;
+        else if (exp > TRACKER_SKETCH_MAX_EXP)
+            index = TRACKER_SKETCH_BUCKETS - 1;
+        else
+            index = (exp - TRACKER_SKETCH_MIN_EXP) * TRACKER_SKETCH_STEPS + (size_t)((mantissa - 0.5) * 2.0 * TRACKER_SKETCH_STEPS);
+        buckets[index]++;
+
+        if (count > 0) {
+            double interval = _startMs - lastStartMs;
+            double delta = interval - intervalMean;
+            intervals++;
+            intervalMean += delta / (double)intervals;
+            intervalM2 += delta * (interval - intervalMean);
+        }
+        lastStartMs = _startMs;
+
+        count++;
+        sum += _durationMs;
+        if (_durationMs > max)
+            max = _durationMs;
+    }
+
+    /** Duration under which there are _q (0 to 1) of the samples **/
+    double  quantile(double _q) const;
+
+    /** Standard deviation of the intervals **/
+    double  jitter() const { return (intervals > 1)? std::sqrt(intervalM2 / (double)(intervals - 1)) : 0.0; }
 };
 
 struct StatTrack {
-    std::string             stack;
+    std::string             name;
     StatPoint               start;
-    std::vector<StatSample> samples;
+    std::vector<StatSample> samples;    // ring of the last TRACKER_RING_SIZE samples
+    size_t                  head;       // where the next sample goes
+    size_t                  count;      // samples taken since start(), even the overwritten ones
     double                  durationAverage;
+    unsigned int            gpuQuery;   // timestamp query issued by begin()
+    bool                    counter;    // samples are values over time instead of spans
+    StatSketch              stats;
+
+    /** Samples still on the ring **/
+    size_t                  size() const { return count < samples.size() ? count : samples.size(); }
+
+    /** i-th sample on the ring, from the oldest one **/
+    const StatSample&       operator[](size_t _i) const { return samples[(head + samples.size() - size() + _i) % samples.size()]; }
 };
 
 class Tracker {
@@ -29,9 +119,49 @@ public:
     void    start();
     void    stop();
 
-    void    begin(const std::string& _track);
-    void    end(const std::string& _track);
+    /** Id of a track, created the first time it's asked for. -1 once the table is full **/
+    int     getTrackId(const std::string& _track);
+    const std::string& getTrackName(int _id) const { return m_tracks[_id].name; }
+
+    void    begin(int _id) {
+        if (!isRunning() || _id < 0)
+            return;
+
+        if (m_gpu)
+            _gpuBegin(m_tracks[_id]);
+        m_tracks[_id].start = StatClock::now();
+    }
+
+    void    end(int _id) {
+        if (!isRunning() || _id < 0)
+            return;
 
+        StatPoint sample_end = StatClock::now();
+        StatTrack& track = m_tracks[_id];
+
+        // skip ends without a begin since start()
+        if (track.start < m_trackerStart)
+            return;
+
+        _add(track, track.start, sample_end);
+        if (m_gpu)
+            _gpuEnd(_id, track, track.count - 1);
+    }
+
+    /** begin() and end() are meant for the render thread and don't lock, so start() and the
+     *  loggers have to be called from it too (the track command goes through the main loop).
+     *  Other threads add the spans they measured with record() and values like queue sizes
+     *  with counter(), on tracks of their own, under the mutex **/
+    void    record(int _id, const StatPoint& _start, const StatPoint& _end);
+    void    counter(int _id, double _value);
+
+    /** Name of the calling thread on traces **/
+    void    setThreadName(const std::string& _name);
+
+    /** Closes a frame, the time between two calls goes to the "frame" track. Once per frame from the render thread **/
+    void    frame();
+
+    /** Frames per second from the median duration of the frames **/
     double  getFramerate();
 
     std::string logSamples();
@@ -40,15 +170,71 @@ public:
     std::string logAverage(const std::string& _track);
     std::string logFramerate();
 
-    bool    isRunning() const { return m_running; }
+    /** Count, mean, p50, p95, p99 and max duration of every track, plus the mean and standard
+     *  deviation (jitter) of the interval between samples, as CSV **/
+    std::string logStats();
+
+    /** Every sample in Chrome's Trace Event Format, for chrome://tracing or Perfetto **/
+    std::string logTrace();
+
+    bool    isRunning() const { return m_running.load(std::memory_order_relaxed); }
+
+    /** Also measures the time each track takes on the GPU, through timestamp queries read some
+     *  frames later. It's ignored where timer queries are not supported **/
+    void    setGpu(bool _gpu) { m_gpu = _gpu; }
+    bool    isGpu() const { return m_gpu; }
+
+    /** Reads the GPU timers that already finished, without waiting for the rest. Once per frame
+     *  from the thread that owns the GL context **/
+    void    collect();
 
 protected:
+    struct GpuQuery {
+        int             track;
+        size_t          sample;     // count of the track when it was taken
+        unsigned int    begin;
+        unsigned int    end;
+        unsigned int    session;
+    };
+
+    void    _gpuBegin(StatTrack& _track);
+    void    _gpuEnd(int _id, StatTrack& _track, size_t _sample);
+    unsigned int _gpuQuery();
+
+    StatSample& _add(StatTrack& _track, const StatPoint& _start, const StatPoint& _end) {
+        StatSample& stat = _track.samples[_track.head];
+        stat.startMs = std::chrono::duration<double, std::milli>(_start - m_trackerStart).count();
+        stat.endMs = std::chrono::duration<double, std::milli>(_end - m_trackerStart).count();
+        stat.durationMs = stat.endMs - stat.startMs;
+        stat.gpuMs = -1.0;
+        stat.thread = trackerThreadId();
+        _track.stats.add(stat.durationMs, stat.startMs);
 
-    double                  m_trackerStart;
+        if (++_track.head == _track.samples.size())
+            _track.head = 0;
+        _track.count++;
+        return stat;
+    }
 
-    std::vector<std::string>            m_tracks;
-    std::map<std::string, StatTrack>    m_data;
+    std::string _logSamples(StatTrack& _track);
+    std::string _logAverage(StatTrack& _track);
 
-    bool                    m_running = false;
+    StatPoint                               m_trackerStart;
 
-};
\ No newline at end of file
+    std::vector<StatTrack>                  m_tracks;
+    std::unordered_map<std::string, int>    m_ids;
+    std::map<uint32_t, std::string>         m_threadNames;
+    StatPoint                               m_lastFrame;
+    int                                     m_frameTrack = -1;
+    std::mutex                              m_mutex;    // interning, start(), the loggers and the other threads' tracks
+
+    std::vector<unsigned int>               m_gpuFree;
+    std::deque<GpuQuery>                    m_gpuPending;
+    size_t                                  m_gpuQueries = 0;
+    unsigned int                            m_session = 0;
+    int                                     m_gpuSupported = -1;
+    bool                                    m_gpu = false;
+
+    std::atomic<bool>       m_running{false};
+
+};
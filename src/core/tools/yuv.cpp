@@ -0,0 +1,143 @@
+#include "yuv.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define YUV_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+// BT.601 limited range in 8 bits fixed point
+inline unsigned char yuvY(int _r, int _g, int _b) { return (unsigned char)((( 66 * _r + 129 * _g +  25 * _b + 128) >> 8) +  16); }
+inline unsigned char yuvU(int _r, int _g, int _b) { return (unsigned char)(((-38 * _r -  74 * _g + 112 * _b + 128) >> 8) + 128); }
+inline unsigned char yuvV(int _r, int _g, int _b) { return (unsigned char)(((112 * _r -  94 * _g -  18 * _b + 128) >> 8) + 128); }
+
+inline const unsigned char* yuvSrcRow(const unsigned char* _rgba, size_t _stride, int _height, int _row, bool _flip) {
+    if (_row >= _height)
+        _row = _height - 1;
+    return _rgba + (size_t)(_flip ? (_height - 1 - _row) : _row) * _stride;
+}
+
+// Converts the columns [_from, _width) of a pair of rows
+void yuvRowsScalar( const unsigned char* _row0, const unsigned char* _row1, int _from, int _width, bool _secondRow,
+                    unsigned char* _y0, unsigned char* _y1, unsigned char* _u, unsigned char* _v ) {
+    for (int x = _from; x < _width; x += 2) {
+        int x1 = (x + 1 < _width)? x + 1 : x;
+        const unsigned char* p00 = _row0 + x * 4;
+        const unsigned char* p01 = _row0 + x1 * 4;
+        const unsigned char* p10 = _row1 + x * 4;
+        const unsigned char* p11 = _row1 + x1 * 4;
+
+        _y0[x] = yuvY(p00[0], p00[1], p00[2]);
+        if (x1 != x)
+            _y0[x1] = yuvY(p01[0], p01[1], p01[2]);
+
+        if (_secondRow) {
+            _y1[x] = yuvY(p10[0], p10[1], p10[2]);
+            if (x1 != x)
+                _y1[x1] = yuvY(p11[0], p11[1], p11[2]);
+        }
+
+        int r = (p00[0] + p01[0] + p10[0] + p11[0] + 2) >> 2;
+        int g = (p00[1] + p01[1] + p10[1] + p11[1] + 2) >> 2;
+        int b = (p00[2] + p01[2] + p10[2] + p11[2] + 2) >> 2;
+        _u[x/2] = yuvU(r, g, b);
+        _v[x/2] = yuvV(r, g, b);
+    }
+}
+
+#if defined(YUV_USE_SSE2)
+
+// Load 8 RGBA pixels as three vectors of 8 x 16bits
+inline void yuvLoad8(const unsigned char* _p, __m128i& _r, __m128i& _g, __m128i& _b) {
+    const __m128i mask = _mm_set1_epi32(0xFF);
+    __m128i a = _mm_loadu_si128((const __m128i*)_p);
+    __m128i b = _mm_loadu_si128((const __m128i*)(_p + 16));
+    _r = _mm_packs_epi32(_mm_and_si128(a, mask), _mm_and_si128(b, mask));
+    _g = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(a, 8), mask), _mm_and_si128(_mm_srli_epi32(b, 8), mask));
+    _b = _mm_packs_epi32(_mm_and_si128(_mm_srli_epi32(a, 16), mask), _mm_and_si128(_mm_srli_epi32(b, 16), mask));
+}
+
+// Luma of 8 pixels in 16 bits. The sum stays under 2^16 so it can be treated as unsigned
+inline __m128i yuvLuma8(__m128i _r, __m128i _g, __m128i _b) {
+    __m128i y = _mm_add_epi16(_mm_mullo_epi16(_r, _mm_set1_epi16(66)), _mm_mullo_epi16(_g, _mm_set1_epi16(129)));
+    y = _mm_add_epi16(y, _mm_mullo_epi16(_b, _mm_set1_epi16(25)));
+    y = _mm_add_epi16(y, _mm_set1_epi16(128));
+    return _mm_add_epi16(_mm_srli_epi16(y, 8), _mm_set1_epi16(16));
+}
+
+// Average of horizontal pairs of two rows already added together (8 columns -> 4 samples in 32 bits)
+inline __m128i yuvBlock4(__m128i _sum) {
+    __m128i s = _mm_madd_epi16(_sum, _mm_set1_epi16(1));
+    return _mm_srli_epi32(_mm_add_epi32(s, _mm_set1_epi32(2)), 2);
+}
+
+inline __m128i yuvChroma8(__m128i _r, __m128i _g, __m128i _b, short _cr, short _cg, short _cb) {
+    __m128i c = _mm_add_epi16(_mm_mullo_epi16(_r, _mm_set1_epi16(_cr)), _mm_mullo_epi16(_g, _mm_set1_epi16(_cg)));
+    c = _mm_add_epi16(c, _mm_mullo_epi16(_b, _mm_set1_epi16(_cb)));
+    c = _mm_add_epi16(c, _mm_set1_epi16(128));
+    return _mm_add_epi16(_mm_srai_epi16(c, 8), _mm_set1_epi16(128));
+}
+
+// Converts 16 columns of a pair of rows
+inline void yuvRows16(  const unsigned char* _row0, const unsigned char* _row1, bool _secondRow,
+                        unsigned char* _y0, unsigned char* _y1, unsigned char* _u, unsigned char* _v ) {
+    __m128i r0a, g0a, b0a, r0b, g0b, b0b;
+    __m128i r1a, g1a, b1a, r1b, g1b, b1b;
+    yuvLoad8(_row0,      r0a, g0a, b0a);
+    yuvLoad8(_row0 + 32, r0b, g0b, b0b);
+    yuvLoad8(_row1,      r1a, g1a, b1a);
+    yuvLoad8(_row1 + 32, r1b, g1b, b1b);
+
+    _mm_storeu_si128((__m128i*)_y0, _mm_packus_epi16(yuvLuma8(r0a, g0a, b0a), yuvLuma8(r0b, g0b, b0b)));
+    if (_secondRow)
+        _mm_storeu_si128((__m128i*)_y1, _mm_packus_epi16(yuvLuma8(r1a, g1a, b1a), yuvLuma8(r1b, g1b, b1b)));
+
+    __m128i r = _mm_packs_epi32(yuvBlock4(_mm_add_epi16(r0a, r1a)), yuvBlock4(_mm_add_epi16(r0b, r1b)));
+    __m128i g = _mm_packs_epi32(yuvBlock4(_mm_add_epi16(g0a, g1a)), yuvBlock4(_mm_add_epi16(g0b, g1b)));
+    __m128i b = _mm_packs_epi32(yuvBlock4(_mm_add_epi16(b0a, b1a)), yuvBlock4(_mm_add_epi16(b0b, b1b)));
+
+    const __m128i zero = _mm_setzero_si128();
+    _mm_storel_epi64((__m128i*)_u, _mm_packus_epi16(yuvChroma8(r, g, b, -38, -74, 112), zero));
+    _mm_storel_epi64((__m128i*)_v, _mm_packus_epi16(yuvChroma8(r, g, b, 112, -94, -18), zero));
+}
+
+#endif
+
+void rgbaToYuv420Scalar(const unsigned char* _rgba, size_t _stride, int _width, int _height, bool _flip,
+                        unsigned char* _y, int _yStride,
+                        unsigned char* _u, int _uStride,
+                        unsigned char* _v, int _vStride ) {
+    for (int row = 0; row < _height; row += 2) {
+        yuvRowsScalar(  yuvSrcRow(_rgba, _stride, _height, row, _flip),
+                        yuvSrcRow(_rgba, _stride, _height, row + 1, _flip),
+                        0, _width, row + 1 < _height,
+                        _y + (size_t)row * _yStride, _y + (size_t)(row + 1) * _yStride,
+                        _u + (size_t)(row / 2) * _uStride, _v + (size_t)(row / 2) * _vStride);
+    }
+}
+
+void rgbaToYuv420(  const unsigned char* _rgba, size_t _stride, int _width, int _height, bool _flip,
+                    unsigned char* _y, int _yStride,
+                    unsigned char* _u, int _uStride,
+                    unsigned char* _v, int _vStride ) {
+    #if defined(YUV_USE_SSE2)
+    for (int row = 0; row < _height; row += 2) {
+        const unsigned char* row0 = yuvSrcRow(_rgba, _stride, _height, row, _flip);
+        const unsigned char* row1 = yuvSrcRow(_rgba, _stride, _height, row + 1, _flip);
+        bool secondRow = row + 1 < _height;
+        unsigned char* y0 = _y + (size_t)row * _yStride;
+        unsigned char* y1 = _y + (size_t)(row + 1) * _yStride;
+        unsigned char* u = _u + (size_t)(row / 2) * _uStride;
+        unsigned char* v = _v + (size_t)(row / 2) * _vStride;
+
+        int x = 0;
+        for (; x + 16 <= _width; x += 16)
+            yuvRows16(row0 + x * 4, row1 + x * 4, secondRow, y0 + x, y1 + x, u + x / 2, v + x / 2);
+
+        // left overs
+        if (x < _width)
+            yuvRowsScalar(row0, row1, x, _width, secondRow, y0, y1, u, v);
+    }
+    #else
+    rgbaToYuv420Scalar(_rgba, _stride, _width, _height, _flip, _y, _yStride, _u, _uStride, _v, _vStride);
+    #endif
+}
@@ -0,0 +1,19 @@
+#pragma once
+
+#include <cstddef>
+
+/** RGBA to planar YUV 4:2:0 (BT.601, limited range) conversion used to feed video encoders.
+ *  Chroma is taken from the average of each 2x2 block. _width and _height should be even,
+ *  _stride is the length in bytes of a source row. With _flip the source rows are read
+ *  bottom-up, which is how glReadPixels leaves them.
+ *  It uses SSE2 when available and a scalar path otherwise, both give the same result. **/
+void rgbaToYuv420(  const unsigned char* _rgba, size_t _stride, int _width, int _height, bool _flip,
+                    unsigned char* _y, int _yStride,
+                    unsigned char* _u, int _uStride,
+                    unsigned char* _v, int _vStride );
+
+/** Same conversion forced through the scalar path. Use it as reference **/
+void rgbaToYuv420Scalar(const unsigned char* _rgba, size_t _stride, int _width, int _height, bool _flip,
+                        unsigned char* _y, int _yStride,
+                        unsigned char* _u, int _uStride,
+                        unsigned char* _v, int _vStride );
@@ -0,0 +1,165 @@
+#include "yuvPass.h"
+
+#include <vector>
+#include <cstdlib>
+#include <iostream>
+
+#include "vera/ops/draw.h"
+#include "vera/shaders/defaultShaders.h"
+
+#include "yuv.h"
+
+const std::string yuv_frag = R"(
+#ifdef GL_ES
+precision highp float;
+#endif
+
+uniform sampler2D   u_tex0;
+uniform vec2        u_resolution;   // of the source frame
+
+// same fixed point math than rgbaToYuv420(), divisions by powers of two are exact
+float luma(vec3 c) { return floor((66.0 * c.r + 129.0 * c.g + 25.0 * c.b + 128.0) * 0.00390625) + 16.0; }
+float chromaU(vec3 c) { return floor((-38.0 * c.r - 74.0 * c.g + 112.0 * c.b + 128.0) * 0.00390625) + 128.0; }
+float chromaV(vec3 c) { return floor((112.0 * c.r - 94.0 * c.g - 18.0 * c.b + 128.0) * 0.00390625) + 128.0; }
+
+// pixel in 0-255 values, _px on image coordinates (top-down)
+vec3 fetch(vec2 _px) {
+    vec2 st = vec2(_px.x + 0.5, u_resolution.y - _px.y - 0.5) / u_resolution;
+    return floor(texture2D(u_tex0, st).rgb * 255.0 + 0.5);
+}
+
+// average of the 2x2 block of a chroma sample
+vec3 block(vec2 _px) {
+    vec2 p = _px * 2.0;
+    vec3 sum = fetch(p) + fetch(p + vec2(1.0, 0.0)) + fetch(p + vec2(0.0, 1.0)) + fetch(p + vec2(1.0, 1.0));
+    return floor((sum + 2.0) * 0.25);
+}
+
+float chroma(vec2 _px, float _isV) {
+    vec3 c = block(_px);
+    return mix(chromaU(c), chromaV(c), _isV);
+}
+
+void main() {
+    vec2 texel = floor(gl_FragCoord.xy);
+    float W = u_resolution.x;
+    float H = u_resolution.y;
+    vec4 color = vec4(0.0);
+
+    if (texel.y < H) {
+        // Y plane: 4 horizontal pixels per texel
+        float x = texel.x * 4.0;
+        color = vec4(   luma(fetch(vec2(x, texel.y))),
+                        luma(fetch(vec2(x + 1.0, texel.y))),
+                        luma(fetch(vec2(x + 2.0, texel.y))),
+                        luma(fetch(vec2(x + 3.0, texel.y))) );
+    }
+    else {
+        // U and V planes: each row of W bytes holds two rows of W/2 chroma samples
+        float isV = step(H * 1.25, texel.y);
+        float row = texel.y - mix(H, H * 1.25, isV);
+        float bx = texel.x * 4.0;
+        float second = step(W * 0.5, bx);
+        vec2 px = vec2(bx - second * W * 0.5, row * 2.0 + second);
+        color = vec4(   chroma(px, isV),
+                        chroma(px + vec2(1.0, 0.0), isV),
+                        chroma(px + vec2(2.0, 0.0), isV),
+                        chroma(px + vec2(3.0, 0.0), isV) );
+    }
+
+    gl_FragColor = color / 255.0;
+}
+)";
+
+YuvPass::YuvPass(): m_width(0), m_height(0) {
+}
+
+YuvPass::~YuvPass() {
+}
+
+bool YuvPass::allocate(int _width, int _height) {
+    if (!isSupported(_width, _height))
+        return false;
+
+    if (!m_shader.isLoaded())
+        m_shader.setSource(yuv_frag, vera::getDefaultSrc(vera::VERT_BILLBOARD));
+
+    m_width = _width;
+    m_height = _height;
+    m_fbo.allocate(getFboWidth(), getFboHeight(), vera::COLOR_TEXTURE);
+    return true;
+}
+
+void YuvPass::_begin() {
+    // values are data, not colors to blend
+    glDisable(GL_BLEND);
+    vera::setDepthTest(false);
+
+    m_fbo.bind();
+    m_shader.use();
+    m_shader.setUniform("u_resolution", (float)m_width, (float)m_height);
+}
+
+void YuvPass::_end() {
+    vera::billboard()->render( &m_shader );
+    m_fbo.unbind();
+    vera::blendMode(vera::BLEND_ALPHA);
+}
+
+void YuvPass::process(const vera::Fbo* _src) {
+    _begin();
+    m_shader.setUniformTexture("u_tex0", _src, 0);
+    _end();
+}
+
+void YuvPass::process(const vera::Texture* _src) {
+    _begin();
+    m_shader.setUniformTexture("u_tex0", _src, 0);
+    _end();
+}
+
+bool YuvPass::check(int _width, int _height) {
+    if (!isSupported(_width, _height)) {
+        std::cout << "GPU YUV needs a width multiple of 8 and a height multiple of 4" << std::endl;
+        return false;
+    }
+
+    std::vector<unsigned char> rgba((size_t)_width * _height * 4);
+    for (size_t i = 0; i < rgba.size(); i++)
+        rgba[i] = (unsigned char)(std::rand() % 256);
+
+    vera::Texture src;
+    src.load(_width, _height, 4, 8, &rgba[0], vera::NEAREST, vera::CLAMP);
+
+    allocate(_width, _height);
+    process(&src);
+
+    const size_t ySize = (size_t)_width * _height;
+    const size_t cSize = ySize / 4;
+    std::vector<unsigned char> gpu(ySize + cSize * 2);
+    std::vector<unsigned char> cpu(ySize + cSize * 2);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, m_fbo.getId());
+    glReadPixels(0, 0, getFboWidth(), getFboHeight(), GL_RGBA, GL_UNSIGNED_BYTE, &gpu[0]);
+    glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+    rgbaToYuv420Scalar( &rgba[0], (size_t)_width * 4, _width, _height, true,
+                        &cpu[0], _width,
+                        &cpu[ySize], _width / 2,
+                        &cpu[ySize + cSize], _width / 2);
+
+    size_t mismatches = 0;
+    int maxDiff = 0;
+    for (size_t i = 0; i < cpu.size(); i++) {
+        int diff = std::abs((int)gpu[i] - (int)cpu[i]);
+        if (diff > 0)
+            mismatches++;
+        if (diff > maxDiff)
+            maxDiff = diff;
+    }
+
+    std::cout << "GPU YUV " << _width << "x" << _height << ": " << mismatches << " of " << cpu.size();
+    std::cout << " bytes differ from the CPU conversion (max difference " << maxDiff << ")" << std::endl;
+
+    return mismatches == 0;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+#include "vera/gl/fbo.h"
+#include "vera/gl/shader.h"
+#include "vera/gl/texture.h"
+
+/** Converts an RGBA frame into planar YUV 4:2:0 on the GPU, so the readback is 1.5 bytes per pixel
+ *  and the encoder gets its native format. The result is packed as RGBA8 on a FBO of
+ *  (width/4 x height*3/2) texels, which read as bytes gives Y, U and V planes one after the other,
+ *  top-down. It follows the same math than rgbaToYuv420() so both outputs can be compared. **/
+class YuvPass {
+public:
+    YuvPass();
+    virtual ~YuvPass();
+
+    static bool isSupported(int _width, int _height) { return _width > 0 && _height > 0 && _width % 8 == 0 && _height % 4 == 0; }
+
+    bool    allocate(int _width, int _height);
+    bool    isAllocated(int _width, int _height) const { return m_fbo.isAllocated() && m_width == _width && m_height == _height; }
+
+    void    process(const vera::Fbo* _src);
+    void    process(const vera::Texture* _src);
+
+    /** Converts a random frame on GPU and CPU and compares them. Returns true if they match **/
+    bool    check(int _width, int _height);
+
+    const vera::Fbo&    getFbo() const { return m_fbo; }
+    int     getFboWidth() const { return m_width / 4; }
+    int     getFboHeight() const { return (m_height * 3) / 2; }
+
+protected:
+    void    _begin();
+    void    _end();
+
+    vera::Shader    m_shader;
+    vera::Fbo       m_fbo;
+    int             m_width;
+    int             m_height;
+};
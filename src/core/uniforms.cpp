@@ -1,7 +1,10 @@
 #include "uniforms.h"
 
 #include <regex>
+#include <algorithm>
 #include <limits>
+#include <cstdlib>
+#include <cstring>
 #include <fstream>
 #include <sstream>
 #include <sys/stat.h>
@@ -10,6 +13,7 @@
 #include <glm/gtc/type_ptr.hpp>
 
 #include "tools/text.h"
+#include "vera/gl/gl.h"
 #include "vera/ops/fs.h"
 #include "vera/ops/draw.h"
 #include "vera/ops/string.h"
@@ -23,16 +27,52 @@ std::string UniformData::getType() {
 
 void UniformData::set(const UniformValue &_value, size_t _size, bool _int, bool _queue) {
     bInt = _int;
-    size = _size;
 
-    if (_queue && change)
+    if (policy == UNIFORM_LATEST)
+        value = _value;
+    else if (policy == UNIFORM_AVERAGE) {
+        // values of another size start a new average
+        if (samples == 0 || size != _size)  {
+            sum = _value;
+            samples = 0;
+        }
+        else
+            for (size_t i = 0; i < _size; i++)
+                sum[i] += _value[i];
+        samples++;
+
+        value = _value;
+        for (size_t i = 0; i < _size; i++)
+            value[i] = sum[i] / (float)samples;
+    }
+    else if (_queue && change) {
+        if (queue.size() >= depth)
+            queue.pop();
         queue.push( _value );
+    }
     else
         value = _value;
-    
+
+    size = _size;
     change = true;
 }
 
+void UniformData::setPolicy(UniformPolicy _policy, size_t _depth) {
+    policy = _policy;
+    depth = (_depth > 0)? _depth : 1;
+
+    // what is pending under the old policy doesn't carry over
+    while (!queue.empty())
+        queue.pop();
+    samples = 0;
+}
+
+std::string UniformData::getPolicy() {
+    if (policy == UNIFORM_LATEST) return "latest";
+    else if (policy == UNIFORM_AVERAGE) return "average";
+    else return "queue," + vera::toString((int)depth);
+}
+
 void UniformData::parse(const std::vector<std::string>& _command, size_t _start, bool _queue) {;
     UniformValue candidate;
     for (size_t i = _start; i < _command.size() && i < 5; i++) 
@@ -52,6 +92,9 @@ std::string UniformData::print() {
 }
 
 bool UniformData::check() {
+    // the next frame averages the values that arrive from now on
+    samples = 0;
+
     if (queue.empty())
         change = false;
     else {
@@ -82,7 +125,7 @@ UniformFunction::UniformFunction(const std::string &_type, std::function<void(ve
 }
 
 
-Uniforms::Uniforms() : m_frame(0), m_play(true) {
+Uniforms::Uniforms() : m_slots(0), m_signature(0), m_signatureDirty(true), m_cacheInvalid(false), m_frame(0), m_play(true) {
 
     activeCubemap = nullptr;
 
@@ -249,112 +292,342 @@ void Uniforms::clear() {
 bool Uniforms::feedTo(vera::Shader *_shader, bool _lights, bool _buffers ) {
     bool update = false;
 
+    // programs were recompiled since the last feed and may reuse the ids of the old ones
+    if (m_cacheInvalid.exchange(false)) {
+        m_programs.clear();
+        m_signatureDirty = true;
+        globals.invalidate();
+    }
+
+    // Programs with the globals block read the per frame uniforms from it
+    bool global = globals.bind(_shader);
+
     // Pass native uniforms functions (u_time, u_data, etc...)
     for (UniformFunctionsMap::iterator it = functions.begin(); it != functions.end(); ++it) {
         if (!_lights && ( it->first == "u_scene" || it->first == "u_sceneDepth" || it->first == "u_sceneNormal" || it->first == "u_scenePosition") )
             continue;
 
+        if (global && it->second.global)
+            continue;
+
         if (it->second.present)
             if (it->second.assign)
                 it->second.assign( *_shader );
     }
 
-    // Pass user defined uniforms (only if the shader code or scene had changed)
-    // if (m_changed) 
-    {
-        for (UniformDataMap::iterator it = data.begin(); it != data.end(); ++it) {
+    // Pass user defined uniforms, only the ones this program doesn't have already
+    UniformProgram& program = m_programs[_shader->getProgram()];
+    UniformCache& cache = program.values;
+    for (UniformDataMap::iterator it = data.begin(); it != data.end(); ++it) {
+        // the ones overriding native uniforms are uploaded every time, after the native value
+        if (it->second.slot == -1)
+            it->second.slot = (functions.find(it->first) == functions.end())? m_slots++ : -2;
+
+        // a policy can be given before any value
+        if (it->second.size == 0)
+            continue;
+
+        if (it->second.slot == -2)
             _shader->setUniform(it->first, it->second.value.data(), it->second.size);
-            if (it->second.change) {
-                update += true;
-            }
+        else
+            _feed(_shader, cache, it->first, it->second.slot, it->second.value, it->second.size);
+        if (it->second.change) {
+            update += true;
         }
     }
 
     // Pass sequence uniforms (the change every frame)
     for (UniformSequenceMap::iterator it = sequences.begin(); it != sequences.end(); ++it) {
         if (it->second.size() > 0) {
+            // the slot of the whole sequence is kept on its first frame
+            if (it->second[0].slot < 0)
+                it->second[0].slot = m_slots++;
+
             size_t frame = m_frame % it->second.size();
-            _shader->setUniform(it->first, it->second[frame].value.data(), it->second[frame].size);
+            _feed(_shader, cache, it->first, it->second[0].slot, it->second[frame].value, it->second[frame].size);
             update += true;
         }
     }
 
-    // Pass Textures Uniforms
+    // Pass textures, streams, buffers and lights through the plan of this program
+    if (_shader->getProgram() != 0) {
+        UniformFeedPlan& plan = program.plans[(_lights ? 2 : 0) + (_buffers ? 1 : 0)];
+        size_t signature = _feedSignature();
+        if (!plan.compiled || plan.signature != signature) {
+            _compilePlan(_shader->getProgram(), plan, _lights, _buffers);
+            plan.signature = signature;
+        }
+        _runPlan(_shader, plan);
+    }
+
+    if (_lights) {
+        if (activeCubemap) {
+            _shader->setUniformTextureCube("u_cubeMap", (vera::TextureCube*)activeCubemap);
+            if (!global)
+                _shader->setUniform("u_SH", activeCubemap->SH, 9);
+        }
+    }
+    return update;
+}
+
+void Uniforms::_feed(vera::Shader* _shader, UniformCache& _cache, const std::string& _name, int _slot, const UniformValue& _value, size_t _size) {
+    unsigned int program = _shader->getProgram();
+    if (program == 0) {
+        _shader->setUniform(_name, _value.data(), _size);
+        return;
+    }
+
+    if ((int)_cache.size() <= _slot)
+        _cache.resize(m_slots);
+
+    UniformCacheEntry& entry = _cache[_slot];
+    if (entry.location == -2)
+        entry.location = glGetUniformLocation(program, _name.c_str());
+
+    if (entry.location < 0 || _size == 0 || _size > _value.size())
+        return;
+
+    if (entry.size == _size && std::equal(_value.begin(), _value.begin() + _size, entry.value.begin()))
+        return;
+
+    // the program is in use, as for any other setUniform()
+    if (_size == 1)         glUniform1f(entry.location, _value[0]);
+    else if (_size == 2)    glUniform2f(entry.location, _value[0], _value[1]);
+    else if (_size == 3)    glUniform3f(entry.location, _value[0], _value[1], _value[2]);
+    else if (_size == 4)    glUniform4f(entry.location, _value[0], _value[1], _value[2], _value[3]);
+    else if (_size == 9)    glUniformMatrix3fv(entry.location, 1, GL_FALSE, _value.data());
+    else if (_size == 16)   glUniformMatrix4fv(entry.location, 1, GL_FALSE, _value.data());
+    else                    glUniform1fv(entry.location, (GLsizei)_size, _value.data());
+
+    entry.value = _value;
+    entry.size = _size;
+}
+
+// Resources are added from many places, so instead of tracking every one of them their
+// identity is hashed once per frame and plans are compiled again when it changes
+static void hashCombine(size_t& _hash, size_t _value) {
+    _hash ^= _value + 0x9e3779b9 + (_hash << 6) + (_hash >> 2);
+}
+
+size_t Uniforms::_feedSignature() {
+    if (!m_signatureDirty)
+        return m_signature;
+
+    size_t hash = 0;
+    for (vera::TexturesMap::iterator it = textures.begin(); it != textures.end(); ++it) {
+        hashCombine(hash, (size_t)&it->first);
+        hashCombine(hash, (size_t)it->second);
+    }
+    for (vera::TextureStreamsMap::iterator it = streams.begin(); it != streams.end(); ++it) {
+        hashCombine(hash, (size_t)&it->first);
+        hashCombine(hash, (size_t)it->second);
+        hashCombine(hash, it->second->getPrevTexturesTotal());
+    }
+    for (size_t i = 0; i < buffers.size(); i++)
+        hashCombine(hash, (size_t)buffers[i]);
+    for (size_t i = 0; i < doubleBuffers.size(); i++)
+        hashCombine(hash, (size_t)doubleBuffers[i]);
+    hashCombine(hash, (size_t)floods.data());
+    hashCombine(hash, floods.size());
+    hashCombine(hash, (size_t)pyramids.data());
+    hashCombine(hash, pyramids.size());
+    for (vera::LightsMap::iterator it = lights.begin(); it != lights.end(); ++it) {
+        hashCombine(hash, (size_t)&it->first);
+        hashCombine(hash, (size_t)it->second);
+    }
+
+    m_signature = hash;
+    m_signatureDirty = false;
+    return m_signature;
+}
+
+void Uniforms::_compilePlan(unsigned int _program, UniformFeedPlan& _plan, bool _lights, bool _buffers) {
+    _plan.steps.clear();
+    _plan.compiled = true;
+
+    // only what the program uses makes it to the plan. Members of the globals block have no location, so they are left out too
+    auto add = [&](const std::string& _name, UniformFeedType _type, void* _source, size_t _index) {
+        GLint location = glGetUniformLocation(_program, _name.c_str());
+        if (location < 0)
+            return;
+
+        UniformFeedStep step;
+        step.location = location;
+        step.type = _type;
+        step.source = _source;
+        step.index = _index;
+        _plan.steps.push_back(step);
+    };
+
     for (vera::TexturesMap::iterator it = textures.begin(); it != textures.end(); ++it) {
-        _shader->setUniformTexture(it->first, it->second, _shader->textureIndex++ );
-        _shader->setUniform(it->first+"Resolution", float(it->second->getWidth()), float(it->second->getHeight()));
+        add(it->first, FEED_TEXTURE, it->second, 0);
+        add(it->first + "Resolution", FEED_TEXTURE_RESOLUTION, it->second, 0);
     }
 
     for (vera::TextureStreamsMap::iterator it = streams.begin(); it != streams.end(); ++it) {
         for (size_t i = 0; i < it->second->getPrevTexturesTotal(); i++)
-            _shader->setUniformTexture(it->first+"Prev["+vera::toString(i)+"]", it->second->getPrevTextureId(i), _shader->textureIndex++);
+            add(it->first + "Prev[" + vera::toString(i) + "]", FEED_STREAM_PREV, it->second, i);
 
-        _shader->setUniform(it->first+"Time", float(it->second->getTime()));
-        _shader->setUniform(it->first+"Fps", float(it->second->getFps()));
-        _shader->setUniform(it->first+"Duration", float(it->second->getDuration()));
-        _shader->setUniform(it->first+"CurrentFrame", float(it->second->getCurrentFrame()));
-        _shader->setUniform(it->first+"TotalFrames", float(it->second->getTotalFrames()));
+        add(it->first + "Time", FEED_STREAM_TIME, it->second, 0);
+        add(it->first + "Fps", FEED_STREAM_FPS, it->second, 0);
+        add(it->first + "Duration", FEED_STREAM_DURATION, it->second, 0);
+        add(it->first + "CurrentFrame", FEED_STREAM_CURRENT_FRAME, it->second, 0);
+        add(it->first + "TotalFrames", FEED_STREAM_TOTAL_FRAMES, it->second, 0);
     }
 
-    // Pass Buffers Texture
     if (_buffers) {
         for (size_t i = 0; i < buffers.size(); i++)
-            _shader->setUniformTexture("u_buffer" + vera::toString(i), buffers[i], _shader->textureIndex++ );
+            add("u_buffer" + vera::toString(i), FEED_FBO, buffers[i], 0);
 
         for (size_t i = 0; i < doubleBuffers.size(); i++)
-            _shader->setUniformTexture("u_doubleBuffer" + vera::toString(i), doubleBuffers[i]->src, _shader->textureIndex++ );
-    
+            add("u_doubleBuffer" + vera::toString(i), FEED_DOUBLEBUFFER, doubleBuffers[i], 0);
+
         for (size_t i = 0; i < floods.size(); i++)
-            _shader->setUniformTexture("u_flood" + vera::toString(i), floods[i].dst, _shader->textureIndex++ );
+            add("u_flood" + vera::toString(i), FEED_FBO, floods[i].dst, 0);
     }
 
-    // Pass Convolution Piramids resultant Texture
     for (size_t i = 0; i < pyramids.size(); i++)
-        _shader->setUniformTexture("u_pyramid" + vera::toString(i), pyramids[i].getResult(), _shader->textureIndex++ );
+        add("u_pyramid" + vera::toString(i), FEED_PYRAMID, &pyramids[i], 0);
 
-    
     if (_lights) {
-        // Pass Light Uniforms
-        if (lights.size() == 1) {
-            vera::LightsMap::iterator it = lights.begin();
-            _shader->setUniform("u_lightColor", it->second->color);
-            _shader->setUniform("u_lightIntensity", it->second->intensity);
-            // if (it->second->getLightType() != vera::LIGHT_DIRECTIONAL)
-            _shader->setUniform("u_light", it->second->getPosition());
-            if (it->second->getLightType() == vera::LIGHT_DIRECTIONAL || it->second->getLightType() == vera::LIGHT_SPOT)
-                _shader->setUniform("u_lightDirection", it->second->direction);
-            if (it->second->falloff > 0)
-                _shader->setUniform("u_lightFalloff", it->second->falloff);
-            _shader->setUniform("u_lightMatrix", it->second->getBiasMVPMatrix() );
-            _shader->setUniformDepthTexture("u_lightShadowMap", it->second->getShadowMap(), _shader->textureIndex++ );
+        for (vera::LightsMap::iterator it = lights.begin(); it != lights.end(); ++it) {
+            std::string name = (lights.size() == 1)? "u_light" : "u_" + it->first;
+            add(name + "Color", FEED_LIGHT_COLOR, it->second, 0);
+            add(name + "Intensity", FEED_LIGHT_INTENSITY, it->second, 0);
+            add(name, FEED_LIGHT_POSITION, it->second, 0);
+            add(name + "Direction", FEED_LIGHT_DIRECTION, it->second, 0);
+            add(name + "Falloff", FEED_LIGHT_FALLOFF, it->second, 0);
+            add(name + "Matrix", FEED_LIGHT_MATRIX, it->second, 0);
+            add(name + "ShadowMap", FEED_LIGHT_SHADOWMAP, it->second, 0);
         }
-        else {
-            // TODO:
-            //      - Lights should be pass as structs?? 
-
-            for (vera::LightsMap::iterator it = lights.begin(); it != lights.end(); ++it) {
-                std::string name = "u_" + it->first;
-
-                _shader->setUniform(name + "Color", it->second->color);
-                _shader->setUniform(name + "Intensity", it->second->intensity);
-                // if (it->second->getLightType() != vera::LIGHT_DIRECTIONAL)
-                _shader->setUniform(name, it->second->getPosition());
-                if (it->second->getLightType() == vera::LIGHT_DIRECTIONAL || it->second->getLightType() == vera::LIGHT_SPOT)
-                    _shader->setUniform(name + "Direction", it->second->direction);
-                if (it->second->falloff > 0)
-                    _shader->setUniform(name +"Falloff", it->second->falloff);
-
-                _shader->setUniform(name + "Matrix", it->second->getBiasMVPMatrix() );
-                _shader->setUniformDepthTexture(name + "ShadowMap", it->second->getShadowMap(), _shader->textureIndex++ );
-            }
-        }
-        
-        if (activeCubemap) {
-            _shader->setUniformTextureCube("u_cubeMap", (vera::TextureCube*)activeCubemap);
-            _shader->setUniform("u_SH", activeCubemap->SH, 9);
+    }
+}
+
+static void bindTexture(GLint _location, GLuint _id, size_t _unit) {
+    glActiveTexture(GL_TEXTURE0 + (GLenum)_unit);
+    glBindTexture(GL_TEXTURE_2D, _id);
+    glUniform1i(_location, (GLint)_unit);
+}
+
+void Uniforms::_runPlan(vera::Shader* _shader, const UniformFeedPlan& _plan) {
+    for (size_t i = 0; i < _plan.steps.size(); i++) {
+        const UniformFeedStep& step = _plan.steps[i];
+
+        switch (step.type) {
+        case FEED_TEXTURE:
+            bindTexture(step.location, ((vera::Texture*)step.source)->getTextureId(), _shader->textureIndex++);
+            break;
+        case FEED_TEXTURE_RESOLUTION: {
+            vera::Texture* texture = (vera::Texture*)step.source;
+            glUniform2f(step.location, float(texture->getWidth()), float(texture->getHeight()));
+        } break;
+
+        case FEED_STREAM_PREV:
+            bindTexture(step.location, ((vera::TextureStream*)step.source)->getPrevTextureId(step.index), _shader->textureIndex++);
+            break;
+        case FEED_STREAM_TIME:
+            glUniform1f(step.location, float(((vera::TextureStream*)step.source)->getTime()));
+            break;
+        case FEED_STREAM_FPS:
+            glUniform1f(step.location, float(((vera::TextureStream*)step.source)->getFps()));
+            break;
+        case FEED_STREAM_DURATION:
+            glUniform1f(step.location, float(((vera::TextureStream*)step.source)->getDuration()));
+            break;
+        case FEED_STREAM_CURRENT_FRAME:
+            glUniform1f(step.location, float(((vera::TextureStream*)step.source)->getCurrentFrame()));
+            break;
+        case FEED_STREAM_TOTAL_FRAMES:
+            glUniform1f(step.location, float(((vera::TextureStream*)step.source)->getTotalFrames()));
+            break;
+
+        case FEED_FBO:
+            bindTexture(step.location, ((vera::Fbo*)step.source)->getTextureId(), _shader->textureIndex++);
+            break;
+        case FEED_DOUBLEBUFFER:
+            bindTexture(step.location, ((vera::PingPong*)step.source)->src->getTextureId(), _shader->textureIndex++);
+            break;
+        case FEED_PYRAMID:
+            bindTexture(step.location, ((vera::Pyramid*)step.source)->getResult()->getTextureId(), _shader->textureIndex++);
+            break;
+
+        case FEED_LIGHT_COLOR: {
+            const glm::vec3& color = ((vera::Light*)step.source)->color;
+            glUniform3f(step.location, color.x, color.y, color.z);
+        } break;
+        case FEED_LIGHT_INTENSITY:
+            glUniform1f(step.location, ((vera::Light*)step.source)->intensity);
+            break;
+        case FEED_LIGHT_POSITION: {
+            glm::vec3 position = ((vera::Light*)step.source)->getPosition();
+            glUniform3f(step.location, position.x, position.y, position.z);
+        } break;
+        case FEED_LIGHT_DIRECTION: {
+            vera::Light* light = (vera::Light*)step.source;
+            if (light->getLightType() == vera::LIGHT_DIRECTIONAL || light->getLightType() == vera::LIGHT_SPOT)
+                glUniform3f(step.location, light->direction.x, light->direction.y, light->direction.z);
+        } break;
+        case FEED_LIGHT_FALLOFF: {
+            vera::Light* light = (vera::Light*)step.source;
+            if (light->falloff > 0)
+                glUniform1f(step.location, light->falloff);
+        } break;
+        case FEED_LIGHT_MATRIX: {
+            glm::mat4 matrix = ((vera::Light*)step.source)->getBiasMVPMatrix();
+            glUniformMatrix4fv(step.location, 1, GL_FALSE, glm::value_ptr(matrix));
+        } break;
+        case FEED_LIGHT_SHADOWMAP:
+            bindTexture(step.location, ((vera::Light*)step.source)->getShadowMap()->getDepthTextureId(), _shader->textureIndex++);
+            break;
         }
     }
-    return update;
+}
+
+void Uniforms::invalidateCache() {
+    m_cacheInvalid.store(true);
+}
+
+void Uniforms::setGlobals(bool _enabled) {
+    for (UniformFunctionsMap::iterator it = functions.begin(); it != functions.end(); ++it)
+        it->second.global = _enabled && GlobalsBlock::has(it->first);
+    globals.setEnabled(_enabled);
+}
+
+bool Uniforms::updateGlobals() {
+    GlobalsData& g = globals.data;
+
+    if (activeCamera) {
+        g.camera = -activeCamera->getPosition();
+        g.cameraTarget = -activeCamera->getTarget();
+        g.cameraDistance = activeCamera->getDistance();
+        g.cameraNearClip = activeCamera->getNearClip();
+        g.cameraFarClip = activeCamera->getFarClip();
+        g.cameraEv100 = activeCamera->getEv100();
+        g.cameraExposure = float(activeCamera->getExposure());
+        g.cameraAperture = activeCamera->getAperture();
+        g.cameraShutterSpeed = activeCamera->getShutterSpeed();
+        g.cameraSensitivity = activeCamera->getSensitivity();
+        g.iblLuminance = float(30000.0 * activeCamera->getExposure());
+    }
+
+    // only a single light goes on the block, several of them keep their own uniforms
+    if (lights.size() == 1) {
+        vera::LightsMap::iterator it = lights.begin();
+        g.light = it->second->getPosition();
+        g.lightColor = it->second->color;
+        g.lightIntensity = it->second->intensity;
+        g.lightDirection = it->second->direction;
+        g.lightFalloff = it->second->falloff;
+        g.lightMatrix = it->second->getBiasMVPMatrix();
+    }
+
+    if (activeCubemap)
+        for (size_t i = 0; i < 9; i++)
+            g.SH[i] = glm::vec4(activeCubemap->SH[i], 0.0f);
+
+    g.play = m_play ? 1 : 0;
+
+    return globals.upload();
 }
 
 void Uniforms::flagChange() {
@@ -440,14 +713,36 @@ void Uniforms::set(const std::string& _name, const std::vector<float>& _data, bo
     m_changed = true;
 }
 
+void Uniforms::set(const std::string& _name, const UniformValue& _value, size_t _size) {
+    data[_name].set(_value, std::min(_size, _value.size()));
+    m_changed = true;
+}
+
+// Lines like "u_value,0.5,1.0" arrive at a high rate from stdin and OSC, they are parsed in place
+// instead of being split in strings
 bool Uniforms::parseLine( const std::string &_line ) {
-    std::vector<std::string> values = vera::split(_line,',');
-    if (values.size() > 1) {
-        data[ values[0] ].parse(values, 1);
-        m_changed = true;
-        return true;
+    size_t comma = _line.find(',');
+    if (comma == std::string::npos || comma == 0)
+        return false;
+
+    UniformValue candidate;
+    size_t size = 0;
+    const char* value = _line.c_str() + comma + 1;
+    while (true) {
+        float number = std::strtof(value, nullptr);
+        if (size < candidate.size())
+            candidate[size] = number;
+        size++;
+
+        value = std::strchr(value, ',');
+        if (value == nullptr)
+            break;
+        value++;
     }
-    return false;
+
+    data[ _line.substr(0, comma) ].set(candidate, std::min(size, candidate.size()));
+    m_changed = true;
+    return true;
 }
 
 bool Uniforms::addSequence( const std::string& _name, const std::string& _filename) {
@@ -479,6 +774,9 @@ bool Uniforms::addSequence( const std::string& _name, const std::string& _filena
 void Uniforms::update() {
     Scene::update();
 
+    // resources may have changed since last frame
+    m_signatureDirty = true;
+
     if (m_play) {
         m_frame++;
         if (m_frame >= std::numeric_limits<size_t>::max()-1)
@@ -535,6 +833,9 @@ void Uniforms::printDefinedUniforms(bool _csv){
     // Print user defined uniform data
     if (_csv) {
         for (UniformDataMap::iterator it= data.begin(); it != data.end(); ++it) {
+            if (it->second.size == 0)
+                continue;
+
             std::cout << it->first;
             for (int i = 0; i < it->second.size; i++) {
                 std::cout << ',' << it->second.value[i];
@@ -551,6 +852,9 @@ void Uniforms::printDefinedUniforms(bool _csv){
     }
     else {
         for (UniformDataMap::iterator it= data.begin(); it != data.end(); ++it) {
+            if (it->second.size == 0)
+                continue;
+
             std::cout << "uniform " << it->second.getType() << "  " << it->first << ";";
             for (int i = 0; i < it->second.size; i++)
                 std::cout << ((i == 0)? " // " : "," ) << it->second.value[i];
@@ -569,11 +873,13 @@ void Uniforms::printDefinedUniforms(bool _csv){
 void Uniforms::addDefine(const std::string& _define, const std::string& _value) {
     for (vera::ModelsMap::iterator it = models.begin(); it != models.end(); ++it)
         it->second->addDefine(_define, _value);
+    invalidateCache();
 }
 
 void Uniforms::delDefine(const std::string& _define) {
     for (vera::ModelsMap::iterator it = models.begin(); it != models.end(); ++it)
         it->second->delDefine(_define);
+    invalidateCache();
 }
 
 void Uniforms::printDefines() {
@@ -617,6 +923,8 @@ void Uniforms::clearBuffers() {
 void Uniforms::clearUniforms() {
     data.clear();
     sequences.clear();
+    invalidateCache();
+    m_slots = 0;
 
     for (UniformFunctionsMap::iterator it = functions.begin(); it != functions.end(); ++it)
         it->second.present = false;
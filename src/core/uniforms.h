@@ -4,12 +4,14 @@
 #include <queue>
 #include <mutex>
 #include <array>
+#include <atomic>
 #include <vector>
 #include <string>
 #include <functional>
 
 #include "tools/files.h"
 #include "tools/tracker.h"
+#include "tools/globalsBlock.h"
 
 #include "vera/gl/flood.h"
 #include "vera/types/scene.h"
@@ -17,19 +19,87 @@
 
 typedef std::array<float, 16> UniformValue;
 
+// Values queued per uniform by default, past that the oldest ones are dropped
+#define UNIFORM_QUEUE_DEPTH 64
+
+// What to do with the values of a uniform that arrive faster than frames are rendered
+enum UniformPolicy {
+    UNIFORM_QUEUE = 0,  // one per frame, in order, up to a depth
+    UNIFORM_LATEST,     // only the last one, so latency doesn't grow with the input rate
+    UNIFORM_AVERAGE     // the mean of the ones that arrived during the frame
+};
+
 struct UniformData {
     std::string getType();
 
     void        set(const UniformValue &_value, size_t _size, bool _int = false, bool _queue = true);
     void        parse(const std::vector<std::string>& _command, size_t _start = 1, bool _queue = true);
+    void        setPolicy(UniformPolicy _policy, size_t _depth = UNIFORM_QUEUE_DEPTH);
+    std::string getPolicy();
     std::string print();
     bool        check();
 
     std::queue<UniformValue>            queue;
     UniformValue                        value;
+    UniformValue                        sum;            // of the values averaged this frame
+    size_t                              samples = 0;
     size_t                              size    = 0;
+    size_t                              depth   = UNIFORM_QUEUE_DEPTH;
+    UniformPolicy                       policy  = UNIFORM_QUEUE;
     bool                                bInt    = false;
     bool                                change  = false;
+    int                                 slot    = -1;   // index on the UniformCache of each program, -2 when not cached
+};
+
+// What was last uploaded to a user uniform of a program, to skip uploading it again while it doesn't change
+struct UniformCacheEntry {
+    int                                 location = -2;  // -2 not looked up yet, -1 not used by the program
+    UniformValue                        value;
+    size_t                              size    = 0;
+};
+typedef std::vector<UniformCacheEntry>  UniformCache;
+
+// What a step of a feed plan uploads and where it reads it from
+enum UniformFeedType {
+    FEED_TEXTURE = 0,               // vera::Texture
+    FEED_TEXTURE_RESOLUTION,
+    FEED_STREAM_PREV,               // index-th previous frame of a vera::TextureStream
+    FEED_STREAM_TIME,
+    FEED_STREAM_FPS,
+    FEED_STREAM_DURATION,
+    FEED_STREAM_CURRENT_FRAME,
+    FEED_STREAM_TOTAL_FRAMES,
+    FEED_FBO,                       // vera::Fbo, for buffers and floods
+    FEED_DOUBLEBUFFER,              // src of a vera::PingPong, it changes on every swap
+    FEED_PYRAMID,                   // result of a vera::Pyramid
+    FEED_LIGHT_COLOR,               // vera::Light
+    FEED_LIGHT_INTENSITY,
+    FEED_LIGHT_POSITION,
+    FEED_LIGHT_DIRECTION,
+    FEED_LIGHT_FALLOFF,
+    FEED_LIGHT_MATRIX,
+    FEED_LIGHT_SHADOWMAP
+};
+
+struct UniformFeedStep {
+    int                                 location;
+    UniformFeedType                     type;
+    void*                               source;
+    size_t                              index   = 0;
+};
+
+// Textures, streams, buffers and lights uniforms a program uses, resolved once. It's compiled
+// again when the program or the resources change
+struct UniformFeedPlan {
+    std::vector<UniformFeedStep>        steps;
+    size_t                              signature = 0;
+    bool                                compiled = false;
+};
+
+// Everything kept for each program
+struct UniformProgram {
+    UniformCache                        values;
+    UniformFeedPlan                     plans[4];   // by _lights and _buffers arguments of feedTo()
 };
 
 struct UniformFunction {
@@ -42,6 +112,7 @@ struct UniformFunction {
     std::function<std::string()>        print;
     std::string                         type;
     bool                                present = false;
+    bool                                global  = false;    // member of the globals block, while it's enabled
 };
 
 // Uniforms values types (float, vecs and functions)
@@ -72,6 +143,10 @@ public:
     // Feed uniforms to a specific shader
     virtual bool        feedTo( vera::Shader *_shader, bool _lights = true, bool _buffers = true);
 
+    // Forget the locations and values uploaded to every program, after they are recompiled. It can
+    // be called from any thread, the cache is dropped by the GL thread on its next feedTo()
+    virtual void        invalidateCache();
+
     // defines
     virtual void        addDefine(const std::string& _define, const std::string& _value);
     virtual void        delDefine(const std::string& _define);
@@ -99,6 +174,7 @@ public:
     virtual void        set( const std::string& _name, float _x, float _y, float _z);
     virtual void        set( const std::string& _name, float _x, float _y, float _z, float _w);
     virtual void        set( const std::string& _name, const std::vector<float>& _data, bool _queue = true);
+    virtual void        set( const std::string& _name, const UniformValue& _value, size_t _size);
     virtual bool        parseLine( const std::string &_line );
 
     UniformSequenceMap  sequences;
@@ -116,12 +192,29 @@ public:
 
     Tracker             tracker;
 
+    // Per frame uniforms on a uniform buffer, for the programs that declare it
+    GlobalsBlock        globals;
+    virtual void        setGlobals(bool _enabled);
+    // Fills the camera, light and spherical harmonics of the block and uploads it. Once per frame
+    virtual bool        updateGlobals();
+
     void                update();
     void                setFrame(size_t _frame) { m_frame = _frame; }
     size_t              getFrame() const { return m_frame; }
     bool                isPlaying() const { return m_play; }
 
 protected:
+    void                _feed(vera::Shader* _shader, UniformCache& _cache, const std::string& _name, int _slot, const UniformValue& _value, size_t _size);
+    size_t              _feedSignature();
+    void                _compilePlan(unsigned int _program, UniformFeedPlan& _plan, bool _lights, bool _buffers);
+    void                _runPlan(vera::Shader* _shader, const UniformFeedPlan& _plan);
+
+    std::map<unsigned int, UniformProgram>  m_programs;
+    int                 m_slots;
+    size_t              m_signature;
+    bool                m_signatureDirty;
+    std::atomic<bool>   m_cacheInvalid;
+
     size_t              m_frame;
     bool                m_play;
 };
@@ -13,8 +13,13 @@
 
 #include <map>
 #include <thread>
+#include <chrono>
 #include <mutex>
 #include <atomic>
+#include <memory>
+#include <cstring>
+#include <unordered_map>
+#include <condition_variable>
 #include <iostream>
 #include <fstream>
 
@@ -36,6 +41,9 @@
 #include "core/tools/text.h"
 #include "core/tools/record.h"
 #include "core/tools/console.h"
+#include "core/tools/sequenceWorkers.h"
+#include "core/tools/rawSequence.h"
+#include "core/tools/mpscQueue.h"
 
 #if defined(SUPPORT_NCURSES)
 #include <ncurses.h>
@@ -43,8 +51,9 @@
 #endif
 
 #if defined(DEBUG)
-#define TRACK_BEGIN(A)      if (sandbox.uniforms.tracker.isRunning()) sandbox.uniforms.tracker.begin(A); 
-#define TRACK_END(A)        if (sandbox.uniforms.tracker.isRunning()) sandbox.uniforms.tracker.end(A); 
+// names are interned once per call site, on its first pass
+#define TRACK_BEGIN(A)      if (sandbox.uniforms.tracker.isRunning()) { static const int trackId = sandbox.uniforms.tracker.getTrackId(A); sandbox.uniforms.tracker.begin(trackId); }
+#define TRACK_END(A)        if (sandbox.uniforms.tracker.isRunning()) { static const int trackId = sandbox.uniforms.tracker.getTrackId(A); sandbox.uniforms.tracker.end(trackId); }
 #else 
 #define TRACK_BEGIN(A)
 #define TRACK_END(A)
@@ -62,6 +71,7 @@ bool                        bStreamsPlaying = true;
 #if !defined(__EMSCRIPTEN__)
 void                        printUsage(char * executableName);
 void                        onExit();
+void                        renderOffline();
 #endif
 
 // The sandbox holds:
@@ -82,8 +92,45 @@ void                        fileWatcherThread();
 // Console COMMAND interface. A way to change the state of internal variables. 
 // Note: the OSC listener reuse it to process events
 CommandList                 commands;
+CommandIndex                commandsIndex;   // built once all the commands are added
 std::mutex                  commandsMutex;
+
+// Commands from other threads (console, -e/-E, OSC) are posted here and applied by the main
+// thread at the start of each loop(), so they never run in the middle of a frame
+#define COMMANDS_QUEUE_SIZE 4096
+#define COMMANDS_BATCH_SIZE 1024    // the most applied per frame, the rest wait for the next one
+#define COMMANDS_MAX_SCHEDULED 1024 // bundles held for later, past that the earliest ones are applied ahead of time
+struct CommandWait {
+    std::mutex              mutex;
+    std::condition_variable done;
+    bool                    finished = false;
+};
+struct CommandBundle;
+struct CommandRequest {
+    std::string                     line;
+    std::shared_ptr<CommandWait>    wait;           // set when the poster waits for it to be applied
+    size_t                          uniform = 0;    // length of the name on "name,v1,v2..." lines that are not commands
+    bool                            skip = false;
+
+    // Uniform values that arrive already typed (OSC) skip the line. The name is on commandsUniforms[slot]
+    int                             slot = -1;
+    UniformValue                    value;
+    size_t                          size = 0;
+
+    // All the requests of an OSC bundle, applied together on the same frame
+    std::shared_ptr<CommandBundle>  bundle;
+};
+struct CommandBundle {
+    std::vector<CommandRequest>     requests;
+    StatPoint                       time;       // when it should be on screen
+};
+MpscQueue<CommandRequest>   commandsQueue(COMMANDS_QUEUE_SIZE);
+// Written once per slot before the first request that uses it and never again, so the main thread reads them without locks
+#define COMMANDS_MAX_UNIFORMS 1024
+std::vector<std::string>    commandsUniforms(COMMANDS_MAX_UNIFORMS);
+std::thread::id             commandsMainThread;
 std::vector<std::string>    commandsArgs;    // Execute commands
+std::vector<std::string>    workersArgs;     // Arguments to launch copies of this session (ex. sequence workers)
 bool                        commandsExit = false;
 #if defined(SUPPORT_NCURSES)
 bool                        commands_ncurses = true;
@@ -91,7 +138,11 @@ bool                        commands_ncurses = true;
 bool                        commands_ncurses = false;
 #endif
 void                        commandsRun(const std::string &_cmd);
-void                        commandsRun(const std::string &_cmd, std::mutex &_mutex);
+void                        commandsRun(const std::string &_cmd, std::mutex &_mutex, bool _wait = true);
+bool                        commandsExec(const std::string &_cmd, std::mutex &_mutex);
+bool                        commandsRequest(const std::string &_cmd, CommandRequest &_request);
+void                        commandsApply(CommandRequest &_request);
+void                        commandsApply();
 void                        commandsInit();
 #if !defined(__EMSCRIPTEN__)
 // Console IN thread
@@ -130,6 +181,13 @@ char* getVert() {
 #if defined(SUPPORT_OSC)
 #include <lo/lo_cpp.h>
 std::mutex                  oscMutex;
+// Address of the messages seen so far and their slot on commandsUniforms, -1 when they go as a line. Only used by the OSC thread
+std::map<std::string, int, std::less<> > oscSlots;
+int                         oscSlot(const char* _path);
+// Bundle being dispatched by liblo, its messages are collected and posted together when it ends. Only used by the OSC thread
+std::shared_ptr<CommandBundle> oscBundle;
+int                         oscBundleDepth = 0;
+void                        oscPost(CommandRequest &&_request);
 #endif
 int                         oscPort = 0;
 // MAIN LOOP
@@ -137,6 +195,14 @@ int                         oscPort = 0;
 EM_BOOL loop (double time, void* userData) {
 #else
 void loop() {
+    // Apply the commands posted since the last frame
+    commandsApply();
+
+    // Offline recordings are driven by their own loop
+    if (isRecording() && isRecordingOffline()) {
+        renderOffline();
+        return;
+    }
 #endif
     // update time/delta/date and input events
     vera::updateGL();
@@ -207,6 +273,8 @@ void loop() {
 // Main program
 //============================================================================
 int main(int argc, char **argv) {
+    sandbox.uniforms.tracker.setThreadName("main");
+    commandsMainThread = std::this_thread::get_id();
 
     // FIRST parsing pass through arguments to understand what kind of 
     // WINDOW PROPERTIES and general enviroment set up needs to be created.
@@ -218,6 +286,24 @@ int main(int argc, char **argv) {
     bool haveGeometry = false;
     bool haveTextures = false;
 
+    // Workers render the same session but without window, console, OSC or the -e/-E commands
+    workersArgs.push_back( std::string(argv[0]) );
+    for (int i = 1; i < argc ; i++) {
+        std::string argument = std::string(argv[i]);
+        if (    argument == "-e"        || argument == "-E"         ||
+                argument == "-p"        || argument == "-port"      || argument == "--port" ||
+                argument == "-x"        || argument == "-y" )
+            i++;
+        else if (   argument == "-headless" || argument == "--headless"     ||
+                    argument == "-noncurses"|| argument == "--noncurses"    ||
+                    argument == "-l"        || argument == "-life-coding"   || argument == "--life-coding"  ||
+                    argument == "-f"        || argument == "-fullscreen"    || argument == "--fullscreen"   ||
+                    argument == "-ss"       || argument == "-screensaver"   || argument == "--screensaver" ) {
+        }
+        else
+            workersArgs.push_back(argument);
+    }
+
     for (int i = 1; i < argc ; i++) {
         std::string argument = std::string(argv[i]);
         if (        argument == "-x" ) {
@@ -291,7 +377,11 @@ int main(int argc, char **argv) {
             else 
                 window_properties.style = vera::UNDECORATED;
         }
-        else if (   argument == "-headless"     || argument == "--headless" )                                   window_properties.style = vera::HEADLESS;
+        else if (   argument == "-headless"     || argument == "--headless" ) {
+            window_properties.style = vera::HEADLESS;
+            // there is nobody watching, so there is no point on pacing recordings to the wall clock
+            setRecordingOffline(true);
+        }
         else if (   argument == "-lenticular"   || argument == "--lenticular")                                  window_properties.style = vera::LENTICULAR;
         else if (   argument == "-f"            || argument == "-fullscreen"    || argument == "--fullscreen")  window_properties.style = vera::FULLSCREEN;
         else if (   argument == "-msaa"         || argument == "--msaa")                                        window_properties.msaa = 4;
@@ -415,6 +505,7 @@ int main(int argc, char **argv) {
 
         // Change internal states with no second parameter
         else if (   argument == "-noncurses"|| argument == "--noncurses"    )   commands_ncurses = false;
+        else if (   argument == "-offline"  || argument == "--offline"      )   setRecordingOffline(true);
         else if (   argument == "-nocursor" || argument == "--nocursor"     )   sandbox.cursor = false;
         else if (   argument == "-verbose"  || argument == "--verbose"      )   sandbox.verbose = true;
         else if (   argument == "-fxaa"     || argument == "--fxaa"         )   sandbox.fxaa = true;
@@ -739,6 +830,7 @@ int main(int argc, char **argv) {
 
     // let sandbox load commands
     sandbox.commandsInit(commands);
+    commandsIndex.build(commands);
 
     // Load files to sandbox
     sandbox.loadAssets(files);
@@ -1084,15 +1176,45 @@ int main(int argc, char **argv) {
         std::cout << "// Listening for OSC commands on port:" << oscPort << std::endl;
     }, [](){});
     oscServer.add_method(0, 0, [](const char *path, lo::Message m) {
+        // straight from liblo's C API, lo::Message copies the types on a string
+        lo_message msg = m;
+        const char* types = lo_message_get_types(msg);
+        size_t total = (size_t)lo_message_get_argc(msg);
+        lo_arg** argv = lo_message_get_argv(msg);
+
+        // Numbers sent to a uniform go straight to its value, without going through a line
+        int slot = (total > 0 && total <= 16)? oscSlot(path) : -1;
+        if (slot >= 0) {
+            CommandRequest request;
+            for (size_t i = 0; i < total && slot >= 0; i++) {
+                if (types[i] == 'f')        request.value[i] = argv[i]->f;
+                else if (types[i] == 'i')   request.value[i] = (float)argv[i]->i;
+                else if (types[i] == 'd')   request.value[i] = (float)argv[i]->d;
+                else if (types[i] == 'h')   request.value[i] = (float)argv[i]->h;
+                else slot = -1;
+            }
+
+            if (slot >= 0) {
+                if (sandbox.verbose) {
+                    std::cout << commandsUniforms[slot];
+                    for (size_t i = 0; i < total; i++)
+                        std::cout << "," << request.value[i];
+                    std::cout << std::endl;
+                }
+
+                request.slot = slot;
+                request.size = total;
+                oscPost( std::move(request) );
+                return;
+            }
+        }
+
         std::string line;
         std::vector<std::string> address = vera::split(std::string(path), '/');
         for (size_t i = 0; i < address.size(); i++)
             line +=  ((i != 0) ? "," : "") + address[i];
 
-        std::string types = m.types();
-        lo_arg** argv = m.argv(); 
-        lo_message msg = m;
-        for (size_t i = 0; i < types.size(); i++) {
+        for (size_t i = 0; i < total; i++) {
             if ( types[i] == 's')
                 line += "," + std::string( (const char*)argv[i] );
             else if (types[i] == 'i')
@@ -1104,7 +1226,41 @@ int main(int argc, char **argv) {
         if (sandbox.verbose)
             std::cout << line << std::endl;
             
-        commandsRun(line, oscMutex);
+        // don't wait for it, the next messages may already be coming
+        CommandRequest request;
+        if (commandsRequest(line, request))
+            oscPost( std::move(request) );
+        else
+            commandsExec(line, oscMutex);
+    });
+
+    // liblo would hold timetagged bundles and then dispatch their messages one by one, which
+    // can split them across frames. Instead they are dispatched as they arrive, collected
+    // and scheduled as a whole by the main loop
+    oscServer.enable_queue(0);
+    oscServer.add_bundle_handlers( [](lo_timetag _time) {
+        // nested bundles go with the outer one
+        if (oscBundleDepth++ > 0)
+            return;
+
+        oscBundle = std::make_shared<CommandBundle>();
+        oscBundle->time = StatClock::now();
+        if (_time.sec != LO_TT_IMMEDIATE.sec || _time.frac != LO_TT_IMMEDIATE.frac) {
+            lo_timetag now;
+            lo_timetag_now(&now);
+            double delay = lo_timetag_diff(_time, now);
+            if (delay > 0.0)
+                oscBundle->time += std::chrono::duration_cast<StatClock::duration>( std::chrono::duration<double>(delay) );
+        }
+    }, []() {
+        if (--oscBundleDepth > 0)
+            return;
+
+        CommandRequest request;
+        request.bundle = oscBundle;
+        oscBundle.reset();
+        if (!request.bundle->requests.empty())
+            commandsQueue.produce( std::move(request) );
     });
 
     if (oscPort > 0) {
@@ -1158,32 +1314,228 @@ int main(int argc, char **argv) {
 // Events
 //============================================================================
 void commandsRun(const std::string &_cmd) { commandsRun(_cmd, commandsMutex); }
-void commandsRun(const std::string &_cmd, std::mutex &_mutex) {
+void commandsRun(const std::string &_cmd, std::mutex &_mutex, bool _wait) {
+    // The main thread can't race with itself, and it would wait for itself
+    if (std::this_thread::get_id() == commandsMainThread) {
+        commandsExec(_cmd, _mutex);
+        return;
+    }
+
+    CommandRequest request;
+    if (!commandsRequest(_cmd, request)) {
+        commandsExec(_cmd, _mutex);
+        return;
+    }
+
+    std::shared_ptr<CommandWait> wait;
+    if (_wait) {
+        wait = std::make_shared<CommandWait>();
+        request.wait = wait;
+    }
+
+    commandsQueue.produce( std::move(request) );
+
+    // Console and -e/-E commands go one after the other, as if they were run right here
+    if (wait) {
+        std::unique_lock<std::mutex> lock(wait->mutex);
+        while (!wait->finished && bKeepRunnig.load())
+            wait->done.wait_for(lock, std::chrono::milliseconds(100));
+    }
+}
+
+bool commandsRequest(const std::string &_cmd, CommandRequest &_request) {
+    thread_local std::vector<size_t> matches;
+    commandsIndex.match(_cmd, matches);
+
+    // Commands without mutex lock by themselves or block until frames are rendered (sequence,
+    // record, wait...), they keep running on the thread that posted them
+    for (size_t m = 0; m < matches.size(); m++) {
+        if (!commands[matches[m]].mutex)
+            return false;
+    }
+
+    _request.line = _cmd;
+    if (matches.empty()) {
+        size_t comma = _cmd.find(',');
+        if (comma != std::string::npos)
+            _request.uniform = comma;
+    }
+    return true;
+}
+
+void commandsApply(CommandRequest &_request) {
+    if (_request.skip)
+        return;
+
+    if (_request.bundle) {
+        for (size_t i = 0; i < _request.bundle->requests.size(); i++)
+            commandsApply(_request.bundle->requests[i]);
+    }
+    else if (_request.slot >= 0) {
+        commandsMutex.lock();
+        sandbox.uniforms.set(commandsUniforms[_request.slot], _request.value, _request.size);
+        commandsMutex.unlock();
+    }
+    else
+        commandsExec(_request.line, commandsMutex);
+}
+
+void commandsApply() {
+    static std::vector<CommandRequest> batch;
+    static std::unordered_map<std::string, size_t> latest;
+    static std::string lineName;
+    static std::multimap<StatPoint, CommandRequest> scheduled;
+
+    // Bundles are held until the frame that will be on screen when their time comes, which
+    // is about one frame from now
+    StatPoint presentation = StatClock::now() + std::chrono::duration_cast<StatClock::duration>( std::chrono::duration<double>(vera::getDelta()) );
+
+    CommandRequest request;
+    size_t early = 0;
+    while (batch.size() < COMMANDS_BATCH_SIZE && commandsQueue.consume(request)) {
+        if (request.bundle && request.bundle->time > presentation) {
+            scheduled.emplace(request.bundle->time, std::move(request));
+
+            // a sender with far future timetags can't grow them without limit
+            if (scheduled.size() > COMMANDS_MAX_SCHEDULED) {
+                batch.push_back( std::move(scheduled.begin()->second) );
+                scheduled.erase(scheduled.begin());
+                early++;
+            }
+        }
+        else
+            batch.push_back( std::move(request) );
+    }
+
+    if (early > 0 && sandbox.verbose)
+        std::cout << "Too many scheduled bundles, " << early << " applied ahead of time" << std::endl;
+
+    // the ones that are due go after what arrived while they waited
+    while (!scheduled.empty() && scheduled.begin()->first <= presentation) {
+        batch.push_back( std::move(scheduled.begin()->second) );
+        scheduled.erase(scheduled.begin());
+    }
+
+    if (batch.empty())
+        return;
+
+    // Only the last value on the batch of each uniform that keeps the latest one survives,
+    // the ones that queue or average them need all. Values inside bundles are never skipped,
+    // but they do hide the loose ones before them
+    const auto uniformName = [&](const CommandRequest& _request) -> const std::string* {
+        if (_request.slot >= 0)
+            return &commandsUniforms[_request.slot];
+        if (_request.uniform == 0)
+            return nullptr;
+        lineName = _request.line.substr(0, _request.uniform);
+        return &lineName;
+    };
+    const auto isLatest = [&](const std::string& _name) {
+        UniformDataMap::iterator it = sandbox.uniforms.data.find(_name);
+        return it != sandbox.uniforms.data.end() && it->second.policy == UNIFORM_LATEST;
+    };
+
+    latest.clear();
+    commandsMutex.lock();
+    for (size_t i = batch.size(); i-- > 0; ) {
+        if (batch[i].bundle) {
+            for (size_t j = 0; j < batch[i].bundle->requests.size(); j++) {
+                const std::string* name = uniformName(batch[i].bundle->requests[j]);
+                if (name && isLatest(*name))
+                    latest.emplace(*name, i);
+            }
+            continue;
+        }
+
+        const std::string* name = uniformName(batch[i]);
+        if (name == nullptr || !isLatest(*name))
+            continue;
+
+        if (!latest.emplace(*name, i).second)
+            batch[i].skip = true;
+    }
+    commandsMutex.unlock();
+
+    for (size_t i = 0; i < batch.size(); i++) {
+        commandsApply(batch[i]);
+
+        if (batch[i].wait) {
+            std::lock_guard<std::mutex> lock(batch[i].wait->mutex);
+            batch[i].wait->finished = true;
+            batch[i].wait->done.notify_all();
+        }
+    }
+    batch.clear();
+}
+
+bool commandsExec(const std::string &_cmd, std::mutex &_mutex) {
     bool resolve = false;
 
-    // Check if _cmd is present in the list of commands
-    for (size_t i = 0; i < commands.size(); i++) {
-        if (vera::beginsWith(_cmd, commands[i].trigger)) {
-            // Do require mutex the thread?
-            if (commands[i].mutex) _mutex.lock();
+    // Commands which trigger _cmd begins with, in the order they were added
+    thread_local std::vector<size_t> matches;
+    commandsIndex.match(_cmd, matches);
 
-            // Execute de command
-            resolve = commands[i].exec(_cmd);
+    for (size_t m = 0; m < matches.size(); m++) {
+        size_t i = matches[m];
 
-            if (commands[i].mutex) _mutex.unlock();
+        // Do require mutex the thread?
+        if (commands[i].mutex) _mutex.lock();
 
-            // If got resolved stop searching
-            if (resolve) break;
+        // Execute de command
+        if (sandbox.uniforms.tracker.isRunning()) {
+            StatPoint start = StatClock::now();
+            resolve = commands[i].exec(_cmd);
+            sandbox.uniforms.tracker.record(sandbox.uniforms.tracker.getTrackId("command:" + commands[i].trigger), start, StatClock::now());
         }
+        else
+            resolve = commands[i].exec(_cmd);
+
+        if (commands[i].mutex) _mutex.unlock();
+
+        // If got resolved stop searching
+        if (resolve) break;
     }
 
     // If nothing match maybe the user is trying to define the content of a uniform
     if (!resolve) {
         _mutex.lock();
-        sandbox.uniforms.parseLine(_cmd);
+        resolve = sandbox.uniforms.parseLine(_cmd);
         _mutex.unlock();
     }
+    return resolve;
+}
+
+#if defined(SUPPORT_OSC)
+void oscPost(CommandRequest &&_request) {
+    if (oscBundle)
+        oscBundle->requests.push_back( std::move(_request) );
+    else
+        commandsQueue.produce( std::move(_request) );
+}
+
+int oscSlot(const char* _path) {
+    std::map<std::string, int, std::less<> >::iterator it = oscSlots.find(_path);
+    if (it != oscSlots.end())
+        return it->second;
+
+    // Only "/name" addresses that don't trigger a command are uniforms, the same ones their line would be
+    int slot = -1;
+    const char* name = _path + 1;
+    if (_path[0] == '/' && name[0] != '\0' && std::strchr(name, '/') == nullptr) {
+        std::vector<size_t> matches;
+        commandsIndex.match(name, matches);
+
+        static int total = 0;
+        if (matches.empty() && total < COMMANDS_MAX_UNIFORMS) {
+            commandsUniforms[total] = name;
+            slot = total++;
+        }
+    }
+
+    oscSlots[_path] = slot;
+    return slot;
 }
+#endif
 
 void commandsInit() {
     
@@ -1329,6 +1681,49 @@ void commandsInit() {
     },
     "screenshot[,<filename>]", "saves a screenshot to a filename", false));
 
+    // Go before "sequence" so they don't get swallowed by it
+    commands.push_back(Command("sequence_format", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 2) {
+            commandsMutex.lock();
+            bool valid = setSequenceFormat(values[1]);
+            commandsMutex.unlock();
+            if (!valid)
+                std::cout << "Unknown format " << values[1] << ". Use png, raw, raw_half, container or container_half" << std::endl;
+            return valid;
+        }
+        else if (values.size() == 1) {
+            std::cout << getSequenceFormatName() << std::endl;
+            return true;
+        }
+        return false;
+    },
+    "sequence_format[,<png|raw|raw_half|container|container_half>]","format of the frames saved by sequence/secs/frames. Raw ones skip encoding, containers go in one .gvr file",false));
+
+    // Used by the workers of a parallel sequence
+    commands.push_back(Command("sequence_slice", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 5) {
+            float origin = vera::toFloat(values[1]);
+            float fps = vera::toFloat(values[2]);
+            int first = vera::toInt(values[3]);
+            int last = vera::toInt(values[4]);
+
+            commandsMutex.lock();
+            recordingStartSlice(origin, fps, first, last);
+            commandsMutex.unlock();
+
+            float pct = 0.0f;
+            while (pct < 1.0f) {
+                pct = recordingWaitProgress(pct);
+                console_draw_pct(pct);
+            }
+            return true;
+        }
+        return false;
+    },
+    "sequence_slice,<origin_sec>,<fps>,<first_frame>,<last_frame>","save the frames [first, last) of a PNG sequence starting at <origin_sec>",false));
+
     commands.push_back(Command("sequence", [&](const std::string& _line){ 
         std::vector<std::string> values = vera::split(_line,',');
         if (values.size() >= 3) {
@@ -1336,33 +1731,35 @@ void commandsInit() {
             float to = vera::toFloat(values[2]);
             float fps = 24.0;
 
-            if (values.size() == 4)
+            if (values.size() >= 4)
                 fps = vera::toFloat(values[3]);
 
             if (from >= to) {
                 from = 0.0;
             }
 
+            // shard the frames across headless copies of this session
+            int workers = 1;
+            if (values.size() >= 5)
+                workers = vera::toInt(values[4]);
+
+            if (workers > 1 || values.size() >= 6)
+                return sequenceWorkers(workersArgs, from, to, fps, (workers > 1)? workers : 1, (values.size() >= 6)? values[5] : "");
+
             commandsMutex.lock();
             recordingStartSecs(from, to, fps);
             commandsMutex.unlock();
 
             float pct = 0.0f;
             while (pct < 1.0f) {
-                // get progres.
-                commandsMutex.lock();
-                pct = getRecordingPercentage();
-                commandsMutex.unlock();
-
+                pct = recordingWaitProgress(pct);
                 console_draw_pct(pct);
-
-                std::this_thread::sleep_for(std::chrono::milliseconds( vera::getRestMs() ));
             }
             return true;
         }
         return false;
     },
-    "sequence,<from_sec>,<to_sec>[,<fps>]","save a PNG sequence <from_sec> <to_sec> at <fps> (default: 24)",false));
+    "sequence,<from_sec>,<to_sec>[,<fps>[,<workers>[,<video>]]]","save a sequence <from_sec> <to_sec> at <fps> (default: 24), optionally rendered by <workers> headless processes and merged into a <video>",false));
 
     commands.push_back(Command("secs", [&](const std::string& _line){ 
         std::vector<std::string> values = vera::split(_line,',');
@@ -1384,14 +1781,8 @@ void commandsInit() {
 
             float pct = 0.0f;
             while (pct < 1.0f) {
-                // get progres.
-                commandsMutex.lock();
-                pct = getRecordingPercentage();
-                commandsMutex.unlock();
-
+                pct = recordingWaitProgress(pct);
                 console_draw_pct(pct);
-
-                std::this_thread::sleep_for(std::chrono::milliseconds( vera::getRestMs() ));
             }
             return true;
         }
@@ -1399,6 +1790,16 @@ void commandsInit() {
     },
     "secs,<A>,<B>[,<fps>]","saves a sequence of images from second A to second B at <fps> (default: 24)", false));
 
+    commands.push_back(Command("raw_convert", [&](const std::string& _line){ 
+        std::vector<std::string> values = vera::split(_line,',');
+        if (values.size() == 3) {
+            rawConvert(values[1], values[2]);
+            return true;
+        }
+        return false;
+    },
+    "raw_convert,<file>.(raw|rawh|gvr),<ext>","convert raw frames or a container into images of type <ext> (ex. png or hdr)",false));
+
     commands.push_back(Command("frames", [&](const std::string& _line){ 
         std::vector<std::string> values = vera::split(_line,',');
         if (values.size() >= 3) {
@@ -1418,15 +1819,8 @@ void commandsInit() {
 
             float pct = 0.0f;
             while (pct < 1.0f) {
-
-                // Check progres.
-                commandsMutex.lock();
-                pct = getRecordingPercentage();
-                commandsMutex.unlock();
-                
+                pct = recordingWaitProgress(pct);
                 console_draw_pct(pct);
-
-                std::this_thread::sleep_for(std::chrono::milliseconds( vera::getRestMs() ));
             }
             return true;
         }
@@ -1475,6 +1869,9 @@ void commandsInit() {
                 settings.trg_height = vera::roundTo( settings.trg_height , 2);
 
                 valid = true;
+                // encode in-process, the ffmpeg arguments are only used if that fails
+                settings.backend = RECORDING_LIBAV;
+                settings.trg_crf = 10;
                 settings.trg_args = "-r " + vera::toString( settings.trg_fps );
                 settings.trg_args += " -c:v libx264";
                 // settings.trg_args += " -b:v 20000k";
@@ -1506,12 +1903,8 @@ void commandsInit() {
 
                 float pct = 0.0f;
                 while (pct < 1.0f) {
-                    commandsMutex.lock();
-                    pct = getRecordingPercentage();
-                    commandsMutex.unlock();
-
+                    pct = recordingWaitProgress(pct);
                     console_draw_pct(pct);
-                    std::this_thread::sleep_for(std::chrono::milliseconds( vera::getRestMs() ));
                 }
             }
 
@@ -1522,6 +1915,25 @@ void commandsInit() {
     "record,<file>,<A>,<B>[,<fps>]","record a video from second <A> to second <B> at <fps> (default: 24.0f)", false));
     #endif
 
+    commands.push_back(Command("offline", [&](const std::string& _line){
+        if (_line == "offline") {
+            std::string rta = isRecordingOffline() ? "on" : "off";
+            std::cout <<  rta << std::endl; 
+            return true;
+        }
+        else {
+            std::vector<std::string> values = vera::split(_line,',');
+            if (values.size() == 2) {
+                commandsMutex.lock();
+                setRecordingOffline(values[1] == "on");
+                commandsMutex.unlock();
+                return true;
+            }
+        }
+        return false;
+    },
+    "offline[,on|off]", "record as fast as possible (on) or paced to the wall clock (off)", false));
+
     // General environment commands
     //
     commands.push_back(Command("fullFps", [&](const std::string& _line){
@@ -1726,7 +2138,7 @@ void commandsInit() {
         }
         return false;
     },
-    "define,<KEYWORD>[,<VALUE>]", "add a define to the shader", false));
+    "define,<KEYWORD>[,<VALUE>]", "add a define to the shader"));
 
     commands.push_back( Command("undefine", [&](const std::string& _line){ 
         std::vector<std::string> values = vera::split(_line,',');
@@ -1736,7 +2148,7 @@ void commandsInit() {
         }
         return false;
     },
-    "undefine,<KEYWORD>", "remove a define on the shader", false));
+    "undefine,<KEYWORD>", "remove a define on the shader"));
 
 
     // Add 3D objects
@@ -2022,7 +2434,8 @@ void printUsage(char * executableName) {
     std::cerr << "      -f  or --fullscreen         # load the window in fullscreen" << std::endl;
     std::cerr << "      -l  or --life-coding        # live code mode, where the billboard is allways visible" << std::endl;
     std::cerr << "      -ss or --screensaver        # screensaver mode, any pressed key will exit" << std::endl;
-    std::cerr << "      --headless                  # headless rendering" << std::endl;
+    std::cerr << "      --headless                  # headless rendering (recordings are offline)" << std::endl;
+    std::cerr << "      --offline                   # render recordings as fast as possible instead of real time" << std::endl;
     std::cerr << "      --nocursor                  # hide cursor" << std::endl;
     std::cerr << "      --nofloor                   # hide cursor" << std::endl;
     std::cerr << "      --noncurses                 # disable ncurses command interface" << std::endl;
@@ -2040,6 +2453,36 @@ void printUsage(char * executableName) {
     std::cerr << "      --help                      # print help for one or all command" << std::endl;
 }
 
+// Render the recording as fast as possible. Time only moves by the recording delta, so there is
+// no need to wait for changes, the wall clock or vsync, and nothing is presented on screen.
+void renderOffline() {
+    int         frames  = getRecordingCount();
+    auto        start   = std::chrono::steady_clock::now();
+
+    while ( isRecording() && isRecordingOffline() && bKeepRunnig.load() && vera::isGL() ) {
+        // loop() doesn't get back here until the recording ends
+        commandsApply();
+
+        vera::updateGL();
+        glClear( GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT );
+
+        sandbox.renderPrep();
+        sandbox.render();
+        sandbox.renderPost();
+        sandbox.renderDone();
+    }
+
+    frames = getRecordingCount() - frames;
+    double secs = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    console_clear();
+    std::cout << "Rendered " << frames << " frames in " << secs << " secs";
+    if (secs > 0.0)
+        std::cout << " (" << frames / secs << " fps)";
+    std::cout << std::endl;
+    console_refresh();
+}
+
 void onExit() {
 
     #if defined(SUPPORT_LIBAV) && !defined(PLATFORM_RPI)
@@ -2059,16 +2502,20 @@ void onExit() {
 //  Watching Thread
 //============================================================================
 void fileWatcherThread() {
+    sandbox.uniforms.tracker.setThreadName("file watcher");
+    const int changeTrack = sandbox.uniforms.tracker.getTrackId("watcher:change");
     struct stat st;
     while ( bKeepRunnig.load() ) {
         for (size_t i = 0; i < files.size(); i++) {
             stat( files[i].path.c_str(), &st );
             int date = st.st_mtime;
             if ( date != files[i].lastChange ) {
+                StatPoint start = StatClock::now();
                 filesMutex.lock();
                 files[i].lastChange = date;
                 sandbox.onFileChange( files, i );
                 filesMutex.unlock();
+                sandbox.uniforms.tracker.record(changeTrack, start, StatClock::now());
             }
         }
         std::this_thread::sleep_for(std::chrono::milliseconds( 500 ));
@@ -2078,6 +2525,7 @@ void fileWatcherThread() {
 //  Command line Thread
 //============================================================================
 void cinWatcherThread() {
+    sandbox.uniforms.tracker.setThreadName("commands");
 
     #if defined(SUPPORT_NCURSES)
     if (commands_ncurses) {
@@ -0,0 +1,74 @@
+// Hammers LockFreeQueue from one producer and one consumer thread.
+// Meant to run under ThreadSanitizer: a data race, a lost or reordered element,
+// or a consumer that sleeps through a produce all make it exit with an error.
+//
+//  lockFreeQueueStress [<elements>]
+
+#include <memory>
+#include <cstdlib>
+#include <thread>
+#include <chrono>
+#include <random>
+#include <iostream>
+
+#include "core/tools/lockFreeQueue.h"
+
+// well under a minute with ThreadSanitizer on a single core
+#define STRESS_ELEMENTS 2000000
+
+int main(int argc, char **argv) {
+    const size_t elements = (argc > 1)? std::strtoull(argv[1], nullptr, 10) : STRESS_ELEMENTS;
+    if (elements == 0) {
+        std::cout << "Usage: lockFreeQueueStress [<elements>]" << std::endl;
+        return 1;
+    }
+
+    // a tiny ring keeps both sides hitting the full and empty paths
+    LockFreeQueue< std::unique_ptr<size_t> > queue(4);
+
+    std::thread producer([&queue, elements]() {
+        std::mt19937 rng(7);
+        for (size_t i = 0; i < elements; i++) {
+            std::unique_ptr<size_t> value(new size_t(i));
+            if (rng() % 2 == 0)
+                queue.produce( std::move(value) );
+            else
+                while ( !queue.tryProduce( std::move(value) ) )
+                    std::this_thread::yield();
+
+            // every now and then let the consumer fall asleep
+            if (rng() % 1000 == 0)
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+        }
+    });
+
+    size_t errors = 0;
+    std::mt19937 rng(11);
+    for (size_t i = 0; i < elements; i++) {
+        std::unique_ptr<size_t> value;
+        // the producer never pauses this long, so a timeout means a missed wakeup
+        if ( !queue.consumeWait(value, std::chrono::seconds(5)) ) {
+            std::cout << "// ERROR: consumer timed out waiting for element " << i << std::endl;
+            errors++;
+            break;
+        }
+
+        if (!value || *value != i) {
+            std::cout << "// ERROR: expected element " << i << std::endl;
+            errors++;
+        }
+
+        // and every now and then let the producer fill the ring and block
+        if (rng() % 1000 == 0)
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+    }
+
+    producer.join();
+
+    if (!queue.empty()) {
+        std::cout << "// ERROR: " << queue.size() << " elements left in the queue" << std::endl;
+        errors++;
+    }
+
+    return errors == 0 ? 0 : 1;
+}
@@ -0,0 +1,128 @@
+// Runs every histogram kernel of the plot command against the scalar reference, on synthetic
+// RGB and RGBA frames, with different amounts of threads and strides, and prints their Mpixels/s.
+// Exits with an error if any of them doesn't match the reference.
+//
+//  plot_bench [<width> <height> [<iterations>]]
+
+#include <chrono>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+
+#include "core/tools/histogram.h"
+
+typedef std::chrono::high_resolution_clock BenchClock;
+
+// Smooth gradients with noise on top, so some bins are crowded like on a real frame
+std::vector<unsigned char> benchFrame(int _width, int _height, int _channels) {
+    std::vector<unsigned char> frame((size_t)_width * _height * _channels);
+    uint32_t seed = 2463534242u;
+    for (int y = 0; y < _height; y++) {
+        for (int x = 0; x < _width; x++) {
+            seed ^= seed << 13; seed ^= seed >> 17; seed ^= seed << 5;
+            unsigned char* p = &frame[((size_t)y * _width + x) * _channels];
+            p[0] = (unsigned char)((x * 255) / _width);
+            p[1] = (unsigned char)((y * 255) / _height);
+            p[2] = (unsigned char)(seed & 0xff);
+            if (_channels == 4)
+                p[3] = 255;
+        }
+    }
+    return frame;
+}
+
+// Only the pixels a strided count looks at, packed, so the scalar kernel can count them too
+std::vector<unsigned char> benchStrided(const std::vector<unsigned char>& _frame, int _width, int _height, int _channels, int _step,
+                                        int& _stridedWidth, int& _stridedHeight) {
+    _stridedWidth = (_width + _step - 1) / _step;
+    _stridedHeight = (_height + _step - 1) / _step;
+    std::vector<unsigned char> strided((size_t)_stridedWidth * _stridedHeight * _channels);
+    for (int y = 0; y < _stridedHeight; y++)
+        for (int x = 0; x < _stridedWidth; x++)
+            for (int c = 0; c < _channels; c++)
+                strided[((size_t)y * _stridedWidth + x) * _channels + c] = _frame[((size_t)y * _step * _width + x * _step) * _channels + c];
+    return strided;
+}
+
+bool benchMatch(const glm::vec4* _a, const glm::vec4* _b) {
+    for (int i = 0; i < 256; i++)
+        if (_a[i] != _b[i])
+            return false;
+    return true;
+}
+
+int main(int argc, char **argv) {
+    int width = 1920;
+    int height = 1080;
+    int iterations = 10;
+    if (argc >= 3) {
+        width = std::atoi(argv[1]);
+        height = std::atoi(argv[2]);
+    }
+    if (argc >= 4)
+        iterations = std::atoi(argv[3]);
+
+    if (width <= 0 || height <= 0 || iterations <= 0) {
+        std::cout << "Usage: plot_bench [<width> <height> [<iterations>]]" << std::endl;
+        return 1;
+    }
+
+    const int threadCounts[] = { 1, 2, 4, 8, 0 };   // 0 picks them from the hardware
+    const int steps[] = { 1, 3 };
+    const double mpixels = (double)width * height * iterations / 1000000.0;
+    size_t errors = 0;
+
+    std::cout << width << "x" << height << " x" << iterations << std::endl;
+    for (int channels = 3; channels <= 4; channels++) {
+        std::vector<unsigned char> frame = benchFrame(width, height, channels);
+        const size_t stride = (size_t)width * channels;
+
+        glm::vec4 reference[256];
+        BenchClock::time_point start = BenchClock::now();
+        for (int i = 0; i < iterations; i++)
+            histogramCountScalar(&frame[0], stride, width, height, channels, reference);
+        double secs = std::chrono::duration<double>(BenchClock::now() - start).count();
+        std::cout << "  " << (channels == 4 ? "RGBA" : "RGB ") << " scalar        " << mpixels / secs << " Mpx/s" << std::endl;
+
+        for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) {
+            glm::vec4 counts[256];
+            start = BenchClock::now();
+            for (int i = 0; i < iterations; i++)
+                histogramCount(&frame[0], stride, width, height, channels, counts, threadCounts[t]);
+            secs = std::chrono::duration<double>(BenchClock::now() - start).count();
+
+            std::string threads = (threadCounts[t] > 0)? std::to_string(threadCounts[t]) : std::string("auto");
+            std::cout << "  " << (channels == 4 ? "RGBA" : "RGB ") << " threads " << threads << (threads.size() < 4 ? std::string(4 - threads.size(), ' ') : "");
+            std::cout << "  " << mpixels / secs << " Mpx/s" << std::endl;
+
+            if (!benchMatch(reference, counts)) {
+                std::cout << "// ERROR: " << channels << " channels on " << threads << " threads doesn't match the scalar reference" << std::endl;
+                errors++;
+            }
+        }
+
+        // strided counts only see one of every step x step pixels
+        for (size_t s = 0; s < sizeof(steps) / sizeof(steps[0]); s++) {
+            if (steps[s] == 1)
+                continue;
+
+            int stridedWidth = 0, stridedHeight = 0;
+            std::vector<unsigned char> strided = benchStrided(frame, width, height, channels, steps[s], stridedWidth, stridedHeight);
+            glm::vec4 stridedReference[256];
+            histogramCountScalar(&strided[0], (size_t)stridedWidth * channels, stridedWidth, stridedHeight, channels, stridedReference);
+
+            for (size_t t = 0; t < sizeof(threadCounts) / sizeof(threadCounts[0]); t++) {
+                glm::vec4 counts[256];
+                histogramCount(&frame[0], stride, width, height, channels, counts, threadCounts[t], steps[s]);
+                if (!benchMatch(stridedReference, counts)) {
+                    std::cout << "// ERROR: " << channels << " channels every " << steps[s] << " pixels on " << threadCounts[t] << " threads doesn't match the scalar reference" << std::endl;
+                    errors++;
+                }
+            }
+        }
+    }
+
+    return errors == 0 ? 0 : 1;
+}